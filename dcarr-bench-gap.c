@@ -0,0 +1,109 @@
+/*
+ * A benchmark of cursor-local edits in gap buffers and plain dcarrs
+ *
+ * Starts with a text of n characters and types k characters at a cursor,
+ * which moves a few characters now and then and jumps to a random
+ * position every 1000 characters, like someone editing a document. This
+ * is done with dcarr_gap_insert and with dcarr_insert. A second run on
+ * the gap buffer also deletes the character before the cursor for every
+ * fourth keystroke, which a plain dcarr has no macro for. Prints the
+ * average time per keystroke.
+ *
+ * gcc -O2 -std=c99 dcarr-bench-gap.c -o dcarr-bench-gap
+ * ./dcarr-bench-gap [n [k]]
+ *
+ * ------------------------------------------------------------------
+ *
+ * The author disclaims copyright to this source code.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include "dcarr.h"
+
+dcarr_define_type(text_t, char);
+dcarr_gap_define_type(gaptext_t, char);
+
+double now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* the next cursor position, the same sequence for each run */
+unsigned int next_cursor(unsigned int *seed, unsigned int cur,
+                         unsigned int len, unsigned int i) {
+	*seed = *seed * 1103515245 + 12345;
+	if (i % 1000 == 0)
+		return (unsigned int)(((unsigned long long)(*seed >> 8) * len) >> 24);
+	if ((*seed >> 16) % 16 == 0) {
+		/* move a few characters left or right */
+		unsigned int d = (*seed >> 20) % 8;
+		return (*seed >> 24) % 2 ? (cur + d < len ? cur + d : len)
+		                         : (cur > d ? cur - d : 0);
+	}
+	return cur;
+}
+
+int main(int argc, char **argv) {
+	unsigned int n = argc > 1 ? (unsigned int)atol(argv[1]) : 1000000;
+	unsigned int k = argc > 2 ? (unsigned int)atol(argv[2]) : 100000;
+	unsigned int i, cur, seed;
+	text_t text;
+	gaptext_t gap;
+	char c;
+	double t;
+
+	printf("n=%u, k=%u\n", n, k);
+
+	dcarr_gap_init(gap);
+	for (i = 0; i < n; i++)
+		dcarr_gap_insert(gap, i, char, 'a' + i % 26);
+	seed = 1;
+	cur = 0;
+	t = now();
+	for (i = 0; i < k; i++) {
+		cur = next_cursor(&seed, cur, gap.len, i);
+		dcarr_gap_insert(gap, cur, char, 'x');
+		cur++;
+	}
+	t = now() - t;
+	printf("dcarr_gap_insert          %10.3f us\n", t / k * 1e6);
+
+	seed = 1;
+	cur = 0;
+	t = now();
+	for (i = 0; i < k; i++) {
+		cur = next_cursor(&seed, cur, gap.len, i);
+		if (i % 4 == 3 && cur > 0) {
+			cur--;
+			dcarr_gap_remove(gap, cur, char, c);
+		} else {
+			dcarr_gap_insert(gap, cur, char, 'x');
+			cur++;
+		}
+	}
+	t = now() - t;
+	printf("dcarr_gap_insert/remove   %10.3f us\n", t / k * 1e6);
+	dcarr_gap_destroy(gap);
+
+	dcarr_init(text);
+	for (i = 0; i < n; i++)
+		dcarr_push(text, char, 'a' + i % 26);
+	seed = 1;
+	cur = 0;
+	t = now();
+	for (i = 0; i < k; i++) {
+		cur = next_cursor(&seed, cur, text.len, i);
+		dcarr_insert(text, cur, char, 'x');
+		cur++;
+	}
+	t = now() - t;
+	printf("dcarr_insert              %10.3f us\n", t / k * 1e6);
+	dcarr_destroy(text);
+
+	(void)c;
+	return 0;
+}
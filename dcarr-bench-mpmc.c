@@ -0,0 +1,121 @@
+/*
+ * A benchmark of the MPMC queue in dcarr.h
+ *
+ * Each of 1 to 64 threads pushes an integer and then shifts one, over and
+ * over, through a dcarr_mpmc queue and through an ordinary dcarr
+ * protected by a mutex. Prints millions of push/shift pairs per second
+ * for each number of threads.
+ *
+ * gcc -O2 -std=c11 -pthread dcarr-bench-mpmc.c -o dcarr-bench-mpmc
+ * ./dcarr-bench-mpmc [pairs]
+ *
+ * ------------------------------------------------------------------
+ *
+ * The author disclaims copyright to this source code.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+#include "dcarr.h"
+
+#define MAX_THREADS 64
+
+dcarr_mpmc_define_type(mpmc_t, unsigned int);
+dcarr_define_type(intarray_t, unsigned int);
+
+static mpmc_t q;
+static intarray_t arr;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static unsigned int per_thread;
+static unsigned long sums[MAX_THREADS];
+
+double now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+void *mpmc_worker(void *arg) {
+	unsigned long sum = 0;
+	unsigned int i, v;
+	int ok;
+	for (i = 0; i < per_thread; i++) {
+		do {
+			dcarr_mpmc_push(q, unsigned int, i, ok);
+			if (!ok) sched_yield();
+		} while (!ok);
+		do {
+			dcarr_mpmc_shift(q, unsigned int, v, ok);
+			if (!ok) sched_yield();
+		} while (!ok);
+		sum += v;
+	}
+	/* stored once, as the slots of sums[] share cache lines */
+	*(unsigned long *)arg = sum;
+	return NULL;
+}
+
+void *mutex_worker(void *arg) {
+	unsigned long sum = 0;
+	unsigned int i, v;
+	int ok;
+	for (i = 0; i < per_thread; i++) {
+		pthread_mutex_lock(&lock);
+		dcarr_push(arr, unsigned int, i);
+		pthread_mutex_unlock(&lock);
+		do {
+			pthread_mutex_lock(&lock);
+			ok = dcarr_len(arr) > 0;
+			if (ok) dcarr_shift(arr, unsigned int, v);
+			pthread_mutex_unlock(&lock);
+			if (!ok) sched_yield();
+		} while (!ok);
+		sum += v;
+	}
+	/* stored once, as the slots of sums[] share cache lines */
+	*(unsigned long *)arg = sum;
+	return NULL;
+}
+
+double run(int threads, void *(*worker)(void *)) {
+	pthread_t tids[MAX_THREADS];
+	unsigned long sum = 0;
+	double t;
+	int i;
+	t = now();
+	for (i = 0; i < threads; i++) {
+		sums[i] = 0;
+		pthread_create(&tids[i], NULL, worker, &sums[i]);
+	}
+	for (i = 0; i < threads; i++) {
+		pthread_join(tids[i], NULL);
+		sum += sums[i];
+	}
+	t = now() - t;
+	if (sum != (unsigned long)threads * per_thread * (per_thread - 1) / 2)
+		printf("wrong sum with %d threads\n", threads);
+	return (double)threads * per_thread / t * 1e-6;
+}
+
+int main(int argc, char **argv) {
+	unsigned int total = argc > 1 ? (unsigned int)atol(argv[1]) : 4000000;
+	int threads;
+
+	dcarr_mpmc_init(q, mpmc_t, 1024);
+	dcarr_init(arr);
+	printf("threads      mpmc M/s   mutex M/s\n");
+	for (threads = 1; threads <= MAX_THREADS; threads *= 2) {
+		double m;
+		per_thread = total / threads;
+		m = run(threads, mpmc_worker);
+		printf("%7d %13.1f %11.1f\n", threads, m, run(threads, mutex_worker));
+	}
+	dcarr_mpmc_destroy(q);
+	dcarr_destroy(arr);
+
+	return 0;
+}
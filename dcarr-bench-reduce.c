@@ -0,0 +1,92 @@
+/*
+ * A benchmark of searching and reductions in dcarr.h
+ *
+ * Scans an array of n ints, wrapped around the end of its buffer, using
+ * dcarr_find (for a value which isn't there), dcarr_count, dcarr_sum,
+ * dcarr_min and dcarr_minmax, and using a loop over dcarr_elem for
+ * comparison. Prints the throughput in GB/s. By default the array is
+ * small enough to stay in the cache.
+ *
+ * gcc -O2 -std=c99 dcarr-bench-reduce.c -o dcarr-bench-reduce
+ * ./dcarr-bench-reduce [n [repeat]]
+ *
+ * Add e.g. -march=native to use the widest vectors of the machine.
+ *
+ * ------------------------------------------------------------------
+ *
+ * The author disclaims copyright to this source code.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include "dcarr.h"
+
+dcarr_define_type(intarray_t, int);
+
+static intarray_t arr;
+static unsigned int n, repeat;
+
+double now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+void report(const char *name, double t, long check) {
+	printf("%-16s %8.2f GB/s   (%ld)\n", name,
+	       (double)n * sizeof(int) * repeat / t * 1e-9, check);
+}
+
+#define BENCH(name, stmt) do{ \
+	unsigned int _r; \
+	long check = 0; \
+	double t = now(); \
+	for (_r = 0; _r < repeat; _r++) { stmt; } \
+	report(name, now() - t, check); \
+}while(0)
+
+int main(int argc, char **argv) {
+	unsigned int i, idx, cnt;
+	long sum;
+	int v, lo, hi;
+
+	n = argc > 1 ? (unsigned int)atol(argv[1]) : 65536;
+	repeat = argc > 2 ? (unsigned int)atol(argv[2]) : 20000;
+
+	/* make the content wrap around */
+	dcarr_init(arr);
+	for (i = 0; i < n; i++)
+		dcarr_push(arr, int, 0);
+	for (i = 0; i < n / 3; i++) {
+		dcarr_shift(arr, int, v);
+		dcarr_push(arr, int, v);
+	}
+	for (i = 0; i < n; i++)
+		dcarr_elem(arr, i) = (int)((i * 2654435761u) >> 12);
+	printf("n=%u, repeat=%u, offset=%u\n", n, repeat, arr.off);
+
+	BENCH("dcarr_find", dcarr_find(arr, int, -1, idx); check += idx);
+	BENCH("dcarr_count", dcarr_count(arr, int, 42, cnt); check += cnt);
+	BENCH("dcarr_sum", dcarr_sum(arr, int, long, sum); check += sum);
+	BENCH("dcarr_min", dcarr_min(arr, int, lo); check += lo);
+	BENCH("dcarr_minmax", dcarr_minmax(arr, int, lo, hi); check += hi - lo);
+
+	BENCH("dcarr_elem find",
+		for (idx = 0; idx < n && dcarr_elem(arr, idx) != -1; idx++);
+		check += idx);
+	BENCH("dcarr_elem count",
+		for (cnt = i = 0; i < n; i++) cnt += dcarr_elem(arr, i) == 42;
+		check += cnt);
+	BENCH("dcarr_elem sum",
+		for (sum = i = 0; i < n; i++) sum += dcarr_elem(arr, i);
+		check += sum);
+	BENCH("dcarr_elem min",
+		for (lo = dcarr_elem(arr, 0), i = 1; i < n; i++)
+			if (dcarr_elem(arr, i) < lo) lo = dcarr_elem(arr, i);
+		check += lo);
+
+	dcarr_destroy(arr);
+	return 0;
+}
@@ -0,0 +1,257 @@
+/*
+ * A benchmark of the lock-free SPSC queue in dcarr.h
+ *
+ * One thread pushes integers and another thread shifts them, through a
+ * dcarr_spsc queue (one element and 64 elements at a time) and through an
+ * ordinary dcarr protected by a mutex. Prints millions of elements per
+ * second for each.
+ *
+ * Then measures the latency of the queue and of the dcarr with a mutex:
+ * one thread sends each integer to another thread, which sends it back
+ * through a second queue. Prints the average and the 99th percentile of
+ * the round trip times.
+ *
+ * gcc -O2 -std=c11 -pthread dcarr-bench-spsc.c -o dcarr-bench-spsc
+ * ./dcarr-bench-spsc [elements [round trips]]
+ *
+ * ------------------------------------------------------------------
+ *
+ * The author disclaims copyright to this source code.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+#include "dcarr.h"
+
+#define BATCH 64
+
+dcarr_spsc_define_type(spsc_t, unsigned int);
+dcarr_define_type(intarray_t, unsigned int);
+
+static spsc_t q, back;
+static intarray_t arr, arr_back;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static unsigned int n, rounds;
+static unsigned long sum;
+static double *samples;
+
+double now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+void *spsc_producer(void *arg) {
+	unsigned int i = 0;
+	int ok;
+	(void)arg;
+	while (i < n) {
+		dcarr_spsc_push(q, unsigned int, i, ok);
+		if (ok) i++;
+		else sched_yield();
+	}
+	return NULL;
+}
+
+void *spsc_consumer(void *arg) {
+	unsigned int i = 0, v;
+	int ok;
+	(void)arg;
+	while (i < n) {
+		dcarr_spsc_shift(q, unsigned int, v, ok);
+		if (ok) { sum += v; i++; }
+		else sched_yield();
+	}
+	return NULL;
+}
+
+void *batch_producer(void *arg) {
+	unsigned int i = 0, j, k, buf[BATCH];
+	(void)arg;
+	while (i < n) {
+		for (j = 0; j < BATCH; j++) buf[j] = i + j;
+		dcarr_spsc_push_n(q, unsigned int, buf,
+		                  n - i < BATCH ? n - i : BATCH, k);
+		if (k) i += k;
+		else sched_yield();
+	}
+	return NULL;
+}
+
+void *batch_consumer(void *arg) {
+	unsigned int i = 0, j, k, buf[BATCH];
+	(void)arg;
+	while (i < n) {
+		dcarr_spsc_shift_n(q, unsigned int, buf, BATCH, k);
+		for (j = 0; j < k; j++) sum += buf[j];
+		if (k) i += k;
+		else sched_yield();
+	}
+	return NULL;
+}
+
+void *mutex_producer(void *arg) {
+	unsigned int i;
+	(void)arg;
+	for (i = 0; i < n; i++) {
+		pthread_mutex_lock(&lock);
+		dcarr_push(arr, unsigned int, i);
+		pthread_mutex_unlock(&lock);
+	}
+	return NULL;
+}
+
+void *mutex_consumer(void *arg) {
+	unsigned int i = 0, v;
+	int ok;
+	(void)arg;
+	while (i < n) {
+		pthread_mutex_lock(&lock);
+		ok = dcarr_len(arr) > 0;
+		if (ok) dcarr_shift(arr, unsigned int, v);
+		pthread_mutex_unlock(&lock);
+		if (ok) { sum += v; i++; }
+		else sched_yield();
+	}
+	return NULL;
+}
+
+/* Sends each value it gets back. */
+void *spsc_echo(void *arg) {
+	unsigned int i = 0, v;
+	int ok;
+	(void)arg;
+	while (i < rounds) {
+		dcarr_spsc_shift(q, unsigned int, v, ok);
+		if (!ok) {
+			sched_yield();
+			continue;
+		}
+		do {
+			dcarr_spsc_push(back, unsigned int, v, ok);
+		} while (!ok);
+		i++;
+	}
+	return NULL;
+}
+
+/* Sends v and waits for it to come back. */
+unsigned int spsc_ping(unsigned int v) {
+	int ok;
+	do {
+		dcarr_spsc_push(q, unsigned int, v, ok);
+	} while (!ok);
+	for (;;) {
+		dcarr_spsc_shift(back, unsigned int, v, ok);
+		if (ok) return v;
+		sched_yield();
+	}
+}
+
+void *mutex_echo(void *arg) {
+	unsigned int i = 0, v;
+	int ok;
+	(void)arg;
+	while (i < rounds) {
+		pthread_mutex_lock(&lock);
+		ok = dcarr_len(arr) > 0;
+		if (ok) {
+			dcarr_shift(arr, unsigned int, v);
+			dcarr_push(arr_back, unsigned int, v);
+		}
+		pthread_mutex_unlock(&lock);
+		if (ok) i++;
+		else sched_yield();
+	}
+	return NULL;
+}
+
+unsigned int mutex_ping(unsigned int v) {
+	int ok;
+	pthread_mutex_lock(&lock);
+	dcarr_push(arr, unsigned int, v);
+	pthread_mutex_unlock(&lock);
+	for (;;) {
+		pthread_mutex_lock(&lock);
+		ok = dcarr_len(arr_back) > 0;
+		if (ok) dcarr_shift(arr_back, unsigned int, v);
+		pthread_mutex_unlock(&lock);
+		if (ok) return v;
+		sched_yield();
+	}
+}
+
+int double_cmp(const void *a, const void *b) {
+	double x = *(const double *)a, y = *(const double *)b;
+	return (x > y) - (x < y);
+}
+
+void run_latency(const char *name, void *(*echo)(void *),
+                 unsigned int (*ping)(unsigned int)) {
+	pthread_t e;
+	unsigned int i, wrong = 0;
+	double t, total = 0;
+	pthread_create(&e, NULL, echo, NULL);
+	for (i = 0; i < rounds; i++) {
+		t = now();
+		wrong |= ping(i) != i;
+		samples[i] = now() - t;
+		total += samples[i];
+	}
+	pthread_join(e, NULL);
+	qsort(samples, rounds, sizeof(double), double_cmp);
+	printf("%-14s %8.2f us avg %8.2f us p99%s\n", name,
+	       total / rounds * 1e6, samples[rounds / 100 * 99] * 1e6,
+	       wrong ? " (wrong value)" : "");
+}
+
+void run(const char *name, void *(*producer)(void *),
+         void *(*consumer)(void *)) {
+	pthread_t p, c;
+	double t;
+	sum = 0;
+	t = now();
+	pthread_create(&p, NULL, producer, NULL);
+	pthread_create(&c, NULL, consumer, NULL);
+	pthread_join(p, NULL);
+	pthread_join(c, NULL);
+	t = now() - t;
+	printf("%-14s %8.1f M/s%s\n", name, n / t * 1e-6,
+	       sum == (unsigned long)n * (n - 1) / 2 ? "" : " (wrong sum)");
+}
+
+int main(int argc, char **argv) {
+	n = argc > 1 ? (unsigned int)atol(argv[1]) : 10000000;
+	rounds = argc > 2 ? (unsigned int)atol(argv[2]) : 100000;
+
+	dcarr_spsc_init(q, unsigned int, 1024);
+	run("spsc", spsc_producer, spsc_consumer);
+	run("spsc batch", batch_producer, batch_consumer);
+	dcarr_spsc_destroy(q);
+
+	dcarr_init(arr);
+	run("mutex dcarr", mutex_producer, mutex_consumer);
+	dcarr_destroy(arr);
+
+	samples = malloc(rounds * sizeof(double));
+	if (!samples || rounds < 100) return 1;
+	printf("round trip\n");
+	dcarr_spsc_init(q, unsigned int, 16);
+	dcarr_spsc_init(back, unsigned int, 16);
+	run_latency("spsc", spsc_echo, spsc_ping);
+	dcarr_spsc_destroy(q);
+	dcarr_spsc_destroy(back);
+
+	dcarr_init(arr);
+	dcarr_init(arr_back);
+	run_latency("mutex dcarr", mutex_echo, mutex_ping);
+	dcarr_destroy(arr);
+	dcarr_destroy(arr_back);
+	free(samples);
+
+	return 0;
+}
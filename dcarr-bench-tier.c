@@ -0,0 +1,84 @@
+/*
+ * A benchmark of middle insertion in tiered arrays and plain dcarrs
+ *
+ * Fills an array with n integers, then inserts k more at random
+ * positions, using dcarr_tier_insert and dcarr_insert. Prints the average
+ * time per insertion. The tier size closest to the square root of n is
+ * used.
+ *
+ * gcc -O2 -std=c99 dcarr-bench-tier.c -o dcarr-bench-tier
+ * ./dcarr-bench-tier [n [k]]
+ *
+ * ------------------------------------------------------------------
+ *
+ * The author disclaims copyright to this source code.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include "dcarr.h"
+
+dcarr_define_type(intarray_t, int);
+dcarr_tier_define_type(tier1k_t, int, 1024);
+dcarr_tier_define_type(tier8k_t, int, 8192);
+
+double now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* the same pseudo-random positions for each array. macros evaluate their
+ * arguments more than once, so store the result first. */
+unsigned int rnd(unsigned int *seed, unsigned int n) {
+	*seed = *seed * 1103515245 + 12345;
+	return (unsigned int)(((unsigned long long)(*seed >> 8) * n) >> 24);
+}
+
+#define BENCH_TIER(arraytype, n, k) do{ \
+	arraytype a; \
+	unsigned int i, pos, seed = 1; \
+	double t; \
+	dcarr_tier_init(a); \
+	for (i = 0; i < (n); i++) \
+		dcarr_tier_push(a, arraytype, (int)i); \
+	t = now(); \
+	for (i = 0; i < (k); i++) { \
+		pos = rnd(&seed, (n) + i); \
+		dcarr_tier_insert(a, pos, arraytype, -(int)i); \
+	} \
+	t = now() - t; \
+	printf("dcarr_tier_insert (%s) %10.3f us\n", #arraytype, \
+	       t / (k) * 1e6); \
+	dcarr_tier_destroy(a); \
+}while(0)
+
+int main(int argc, char **argv) {
+	unsigned int n = argc > 1 ? (unsigned int)atol(argv[1]) : 1000000;
+	unsigned int k = argc > 2 ? (unsigned int)atol(argv[2]) : 1000;
+	unsigned int i, pos, seed = 1;
+	intarray_t arr;
+	double t;
+
+	printf("n=%u, k=%u\n", n, k);
+	if (n < 1024 * 8192)
+		BENCH_TIER(tier1k_t, n, k);
+	else
+		BENCH_TIER(tier8k_t, n, k);
+
+	dcarr_init(arr);
+	for (i = 0; i < n; i++)
+		dcarr_push(arr, int, (int)i);
+	t = now();
+	for (i = 0; i < k; i++) {
+		pos = rnd(&seed, n + i);
+		dcarr_insert(arr, pos, int, -(int)i);
+	}
+	t = now() - t;
+	printf("dcarr_insert                %10.3f us\n", t / k * 1e6);
+	dcarr_destroy(arr);
+
+	return 0;
+}
@@ -0,0 +1,79 @@
+/*
+ * A benchmark of sliding window minimum in dcarr.h
+ *
+ * Computes the minimum of the last w values for each of n random values,
+ * using dcarr_window_min and by rescanning the last w values kept in a
+ * dcarr, for a few window sizes. Prints the average time per value.
+ *
+ * gcc -O2 -std=c99 dcarr-bench-window.c -o dcarr-bench-window
+ * ./dcarr-bench-window [n]
+ *
+ * ------------------------------------------------------------------
+ *
+ * The author disclaims copyright to this source code.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include "dcarr.h"
+
+dcarr_window_define_type(window_t, int);
+dcarr_define_type(intarray_t, int);
+
+double now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char **argv) {
+	unsigned int n = argc > 1 ? (unsigned int)atol(argv[1]) : 1000000;
+	unsigned int sizes[] = {16, 256, 4096};
+	unsigned int s, i, j, seed;
+	long check1, check2;
+	int min;
+	double t1, t2;
+
+	printf("window   dcarr_window_min   rescan\n");
+	for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+		window_t w;
+		intarray_t last;
+
+		dcarr_window_init(w, sizes[s]);
+		seed = 1;
+		check1 = 0;
+		t1 = now();
+		for (i = 0; i < n; i++) {
+			seed = seed * 1103515245 + 12345;
+			dcarr_window_min(w, window_t, (int)(seed >> 8), min);
+			check1 += min;
+		}
+		t1 = now() - t1;
+		dcarr_window_destroy(w);
+
+		dcarr_init(last);
+		seed = 1;
+		check2 = 0;
+		t2 = now();
+		for (i = 0; i < n; i++) {
+			seed = seed * 1103515245 + 12345;
+			dcarr_push(last, int, (int)(seed >> 8));
+			if (dcarr_len(last) > sizes[s])
+				dcarr_shift(last, int, min);
+			min = dcarr_elem(last, 0);
+			for (j = 1; j < dcarr_len(last); j++)
+				if (dcarr_elem(last, j) < min)
+					min = dcarr_elem(last, j);
+			check2 += min;
+		}
+		t2 = now() - t2;
+		dcarr_destroy(last);
+
+		printf("%6u %15.1f ns %9.1f ns%s\n", sizes[s], t1 / n * 1e9,
+		       t2 / n * 1e9, check1 == check2 ? "" : " (mismatch)");
+	}
+
+	return 0;
+}
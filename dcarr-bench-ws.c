@@ -0,0 +1,111 @@
+/*
+ * A fork-join benchmark of the work-stealing deque in dcarr.h
+ *
+ * Runs a binary tree of tasks on 1 to 16 worker threads, each owning a
+ * dcarr_ws deque. A task of depth d > 0 pushes two tasks of depth d - 1
+ * to its worker's deque. A worker whose deque is empty steals from the
+ * others. The deques start small, so they also grow and retire buffers
+ * while being stolen from. Prints millions of tasks per second, how many
+ * steals succeeded and how many retired buffers were left to free at the
+ * end.
+ *
+ * gcc -O2 -std=c11 -pthread dcarr-bench-ws.c -o dcarr-bench-ws
+ * ./dcarr-bench-ws [depth]
+ *
+ * ------------------------------------------------------------------
+ *
+ * The author disclaims copyright to this source code.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+#include "dcarr.h"
+
+#define MAX_THREADS 16
+
+dcarr_ws_define_type(deque_t, unsigned int);
+
+static deque_t deques[MAX_THREADS];
+static int nthreads;
+static unsigned long leaves;
+static atomic_ulong leaves_done;
+static unsigned long steals[MAX_THREADS];
+
+double now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+void *worker(void *arg) {
+	int self = (int)((deque_t *)arg - deques), victim;
+	unsigned int task, seed = self + 1;
+	unsigned long done = 0, stolen = 0;
+	int ok;
+	while (atomic_load_explicit(&leaves_done, memory_order_relaxed) < leaves) {
+		dcarr_ws_pop(deques[self], deque_t, task, ok);
+		if (!ok && nthreads > 1) {
+			seed = seed * 1103515245 + 12345;
+			victim = (int)(seed >> 16) % (nthreads - 1);
+			if (victim >= self) victim++;
+			dcarr_ws_steal(deques[victim], deque_t, task, ok);
+			if (ok) stolen++;
+		}
+		if (!ok) {
+			/* out of work. count the leaves so far. */
+			atomic_fetch_add(&leaves_done, done);
+			done = 0;
+			sched_yield();
+			continue;
+		}
+		if (task > 0) {
+			dcarr_ws_push(deques[self], deque_t, task - 1);
+			dcarr_ws_push(deques[self], deque_t, task - 1);
+		} else if (++done == 256) {
+			atomic_fetch_add(&leaves_done, done);
+			done = 0;
+		}
+	}
+	atomic_fetch_add(&leaves_done, done);
+	/* stored once, as the slots of steals[] share cache lines */
+	steals[self] = stolen;
+	return NULL;
+}
+
+int main(int argc, char **argv) {
+	unsigned int depth = argc > 1 ? (unsigned int)atoi(argv[1]) : 22;
+	pthread_t tids[MAX_THREADS];
+	unsigned long total_steals;
+	int i, retired;
+	double t;
+
+	leaves = 1UL << depth;
+	printf("threads   tasks M/s      steals  retired left\n");
+	for (nthreads = 1; nthreads <= MAX_THREADS; nthreads *= 2) {
+		for (i = 0; i < nthreads; i++)
+			dcarr_ws_init(deques[i], deque_t, 4);
+		atomic_store(&leaves_done, 0);
+		dcarr_ws_push(deques[0], deque_t, depth);
+		t = now();
+		for (i = 0; i < nthreads; i++)
+			pthread_create(&tids[i], NULL, worker, &deques[i]);
+		for (i = 0; i < nthreads; i++)
+			pthread_join(tids[i], NULL);
+		t = now() - t;
+		total_steals = retired = 0;
+		for (i = 0; i < nthreads; i++) {
+			deque_t_buf *r;
+			for (r = deques[i].retired; r; r = r->prev) retired++;
+			total_steals += steals[i];
+			dcarr_ws_destroy(deques[i]);
+		}
+		printf("%7d %11.1f %11lu %14d\n", nthreads,
+		       (2.0 * leaves - 1) / t * 1e-6, total_steals, retired);
+	}
+
+	return 0;
+}
@@ -68,6 +68,9 @@ int main() {
 		}
 	}
 
+	/* print operation counters (only with -DDCARR_STATS) */
+	dcarr_stats_dump(arr, stdout);
+
 	/* free allocated memory */
 	dcarr_destroy(arr);
 
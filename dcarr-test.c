@@ -0,0 +1,1346 @@
+/*
+ * Tests for dcarr.h
+ *
+ * Runs each family of macros on random operations and compares the
+ * results with a plain C array, or a simple loop, doing the same thing.
+ * Prints the checks which failed and exits with status 1 if there were
+ * any.
+ *
+ * gcc -Wall -pedantic -std=c11 -pthread dcarr-test.c -o dcarr-test
+ * ./dcarr-test
+ *
+ * With -std=c99 the lock-free queues are left out. Add -DDCARR_STATS to
+ * test the operation counters too.
+ *
+ * ------------------------------------------------------------------
+ *
+ * The author disclaims copyright to this source code.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "dcarr.h"
+#ifdef DCARR_ATOMICS
+#include <sched.h>
+#include <pthread.h>
+#endif
+
+dcarr_define_type(intarray_t, int);
+
+/* the longest reference array */
+#define MAXLEN 4096
+
+static int failures = 0;
+
+/* Reports a failed check. Gives up after many failures. */
+#define check(cond) do{ \
+	if (!(cond)) { \
+		printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+		if (++failures >= 20) exit(1); \
+	} \
+}while(0)
+
+/* A pseudo random number in [0, n). Same sequence on all platforms. */
+static unsigned int rnd(unsigned int n) {
+	static unsigned int seed = 1;
+	seed = seed * 1103515245u + 12345u;
+	return (seed >> 8) % n;
+}
+
+/* qsort int comparison function */
+int int_cmp(const void *a, const void *b) {
+	int x = *(const int *)a, y = *(const int *)b;
+	return (x > y) - (x < y);
+}
+
+/*
+ * Initializes a with the n elements of ref. Pushing and shifting some
+ * elements first makes the content start at an offset, often wrapped.
+ */
+void fill(intarray_t *a, const int *ref, unsigned int n, unsigned int skew) {
+	unsigned int i;
+	int v;
+	dcarr_init(*a);
+	for (i = 0; i < skew; i++)
+		dcarr_push(*a, int, 0);
+	for (i = 0; i < skew; i++)
+		dcarr_shift(*a, int, v);
+	(void)v;
+	for (i = 0; i < n; i++)
+		dcarr_push(*a, int, ref[i]);
+}
+
+/* Returns 1 if a has the n elements of ref. */
+int same(intarray_t *a, const int *ref, unsigned int n) {
+	unsigned int i;
+	if (dcarr_len(*a) != n)
+		return 0;
+	for (i = 0; i < n; i++)
+		if (dcarr_elem(*a, i) != ref[i])
+			return 0;
+	return 1;
+}
+
+/*
+ * push, unshift, pop, shift, insert, resize and sort on an initialized
+ * empty array, which is destroyed at the end.
+ */
+void test_ops(intarray_t *a) {
+	static int ref[MAXLEN];
+	unsigned int n = 0, i, op;
+	int v;
+
+	for (op = 0; op < 30000; op++) {
+		switch (n == 0 ? rnd(3) : rnd(7)) {
+		case 0:
+			if (n == MAXLEN) break;
+			dcarr_push(*a, int, (int)op);
+			ref[n++] = (int)op;
+			break;
+		case 1:
+			if (n == MAXLEN) break;
+			dcarr_unshift(*a, int, (int)op);
+			memmove(ref + 1, ref, n * sizeof(int));
+			ref[0] = (int)op;
+			n++;
+			break;
+		case 2:
+			if (n == MAXLEN) break;
+			i = rnd(n + 1);
+			dcarr_insert(*a, i, int, (int)op);
+			memmove(ref + i + 1, ref + i, (n - i) * sizeof(int));
+			ref[i] = (int)op;
+			n++;
+			break;
+		case 3:
+			dcarr_pop(*a, int, v);
+			check(v == ref[--n]);
+			break;
+		case 4:
+			dcarr_shift(*a, int, v);
+			check(v == ref[0]);
+			memmove(ref, ref + 1, --n * sizeof(int));
+			break;
+		case 5:
+			i = rnd(n / 2 + 1);
+			dcarr_resize(*a, int, i);
+			n = i;
+			break;
+		case 6:
+			i = n + rnd(8);
+			if (i > MAXLEN) break;
+			dcarr_resize(*a, int, i);
+			for (; n < i; n++)
+				dcarr_elem(*a, n) = ref[n] = -(int)n;
+			break;
+		}
+		if (op % 97 == 0)
+			check(same(a, ref, n));
+	}
+	check(same(a, ref, n));
+	dcarr_sort(*a, int, int_cmp);
+	qsort(ref, n, sizeof(int), int_cmp);
+	check(same(a, ref, n));
+	dcarr_destroy(*a);
+}
+
+void test_basic(void) {
+	intarray_t a;
+	dcarr_init(a);
+	test_ops(&a);
+}
+
+#ifdef DCARR_STATS
+void test_stats(void) {
+	intarray_t a;
+	int i, v;
+	dcarr_init(a);
+	for (i = 0; i < 1000; i++)
+		dcarr_push(a, int, i);
+	check(a.stats.reserves > 0);
+	check(a.stats.peak_cap >= 1000);
+	dcarr_insert(a, 1, int, 0);
+	check(a.stats.moved > 0);
+	for (i = 0; i < 1000; i++)
+		dcarr_pop(a, int, v);
+	(void)v;
+	check(a.stats.shrinks > 0);
+	dcarr_stats_reset(a);
+	check(a.stats.reserves == 0 && a.stats.moved == 0);
+	dcarr_destroy(a);
+}
+#endif
+
+dcarr_inc_define_type(incarray_t, int);
+
+/* The reference is kept in the middle of a C array */
+void test_inc(void) {
+	static int ref[2 * MAXLEN];
+	incarray_t a;
+	unsigned int lo = MAXLEN, hi = MAXLEN, i, op;
+	int v;
+
+	dcarr_inc_init(a);
+	for (op = 0; op < 100000; op++) {
+		switch (hi == lo ? rnd(2) : rnd(5)) {
+		case 0:
+			if (hi == 2 * MAXLEN) break;
+			dcarr_inc_push(a, int, (int)op);
+			ref[hi++] = (int)op;
+			break;
+		case 1:
+			if (lo == 0) break;
+			dcarr_inc_unshift(a, int, (int)op);
+			ref[--lo] = (int)op;
+			break;
+		case 2:
+			dcarr_inc_pop(a, int, v);
+			check(v == ref[--hi]);
+			break;
+		case 3:
+			dcarr_inc_shift(a, int, v);
+			check(v == ref[lo++]);
+			break;
+		case 4:
+			if (rnd(100) == 0)
+				dcarr_inc_reserve(a, int, rnd(1000));
+			else if (rnd(100) == 0)
+				dcarr_inc_finish(a, int);
+			break;
+		}
+		if (op % 101 == 0) {
+			check(dcarr_len(a) == hi - lo);
+			for (i = 0; i < hi - lo; i++)
+				check(dcarr_inc_elem(a, i) == ref[lo + i]);
+		}
+	}
+	dcarr_inc_destroy(a);
+}
+
+#ifdef DCARR_ATOMICS
+
+#define NITEMS 200000
+#define NTHREADS 3
+
+dcarr_spsc_define_type(spsc_t, unsigned int);
+
+static spsc_t spsc;
+
+void *spsc_producer(void *arg) {
+	unsigned int i = 0, j, done, ok, buf[64];
+	(void)arg;
+	while (i < NITEMS) {
+		if (i % 2) {
+			dcarr_spsc_push(spsc, unsigned int, i, ok);
+			i += ok;
+		} else {
+			for (j = 0; j < 64; j++)
+				buf[j] = i + j;
+			j = NITEMS - i < 64 ? NITEMS - i : 64;
+			dcarr_spsc_push_n(spsc, unsigned int, buf, j, done);
+			ok = done;
+			i += done;
+		}
+		if (!ok)
+			sched_yield();
+	}
+	return NULL;
+}
+
+/* Fills to the capacity rounded up, keeps the order between threads */
+void test_spsc(void) {
+	pthread_t t;
+	unsigned int i, k, v, ok, done, len, buf[50];
+
+	dcarr_spsc_init(spsc, unsigned int, 100);
+	for (i = 0; i < 200; i++) {
+		dcarr_spsc_push(spsc, unsigned int, i, ok);
+		if (!ok) break;
+	}
+	dcarr_spsc_len(spsc, len);
+	check(i == 128 && len == 128);
+	dcarr_spsc_shift_n(spsc, unsigned int, buf, 50, done);
+	check(done == 50 && buf[0] == 0 && buf[49] == 49);
+	for (i = 50; i < 128; i++) {
+		dcarr_spsc_shift(spsc, unsigned int, v, ok);
+		check(ok && v == i);
+	}
+	dcarr_spsc_shift(spsc, unsigned int, v, ok);
+	check(!ok);
+
+	pthread_create(&t, NULL, spsc_producer, NULL);
+	for (i = 0; i < NITEMS; ) {
+		dcarr_spsc_shift_n(spsc, unsigned int, buf, 1 + i % 50, done);
+		for (k = 0; k < done; k++)
+			check(buf[k] == i + k);
+		i += done;
+		if (!done)
+			sched_yield();
+	}
+	pthread_join(t, NULL);
+	dcarr_spsc_destroy(spsc);
+}
+
+#endif /* DCARR_ATOMICS */
+
+#ifdef DCARR_ATOMICS
+
+dcarr_mpmc_define_type(mpmc_t, unsigned int);
+
+static mpmc_t mpmc;
+static atomic_ulong total;
+static atomic_uint taken;
+
+void *mpmc_producer(void *arg) {
+	unsigned int i, ok, base = (unsigned int)(size_t)arg;
+	for (i = 0; i < NITEMS; ) {
+		dcarr_mpmc_push(mpmc, unsigned int, base + i, ok);
+		if (ok)
+			i++;
+		else
+			sched_yield();
+	}
+	return NULL;
+}
+
+void *mpmc_consumer(void *arg) {
+	unsigned int v, ok;
+	(void)arg;
+	while (atomic_load(&taken) < NTHREADS * NITEMS) {
+		dcarr_mpmc_shift(mpmc, unsigned int, v, ok);
+		if (ok) {
+			atomic_fetch_add(&total, v);
+			atomic_fetch_add(&taken, 1);
+		} else {
+			sched_yield();
+		}
+	}
+	return NULL;
+}
+
+/* FIFO in one thread, nothing lost or duplicated when shared */
+void test_mpmc(void) {
+	pthread_t t[2 * NTHREADS];
+	unsigned int i, v, ok;
+	int k;
+
+	/* a capacity of 1 is taken as 2 */
+	dcarr_mpmc_init(mpmc, mpmc_t, 1);
+	for (k = 0; k < 5; k++) {
+		for (i = 0; i < 3; i++) {
+			dcarr_mpmc_push(mpmc, unsigned int, i, ok);
+			check(ok == (i < 2));
+		}
+		for (i = 0; i < 3; i++) {
+			dcarr_mpmc_shift(mpmc, unsigned int, v, ok);
+			check(ok == (i < 2) && (!ok || v == i));
+		}
+	}
+	dcarr_mpmc_destroy(mpmc);
+
+	dcarr_mpmc_init(mpmc, mpmc_t, 100);
+	for (i = 0; i < 200; i++) {
+		dcarr_mpmc_push(mpmc, unsigned int, i, ok);
+		if (!ok) break;
+	}
+	check(i == 128);
+	for (i = 0; i < 128; i++) {
+		dcarr_mpmc_shift(mpmc, unsigned int, v, ok);
+		check(ok && v == i);
+	}
+	dcarr_mpmc_shift(mpmc, unsigned int, v, ok);
+	check(!ok);
+
+	atomic_store(&total, 0);
+	atomic_store(&taken, 0);
+	for (k = 0; k < NTHREADS; k++) {
+		pthread_create(&t[k], NULL, mpmc_producer,
+		               (void *)(size_t)(k * NITEMS));
+		pthread_create(&t[NTHREADS + k], NULL, mpmc_consumer, NULL);
+	}
+	for (k = 0; k < 2 * NTHREADS; k++)
+		pthread_join(t[k], NULL);
+	check(atomic_load(&total) ==
+	      (unsigned long)NTHREADS * NITEMS * (NTHREADS * NITEMS - 1) / 2);
+	dcarr_mpmc_destroy(mpmc);
+}
+
+#endif /* DCARR_ATOMICS */
+
+#ifdef DCARR_ATOMICS
+
+dcarr_ws_define_type(ws_t, long);
+
+static ws_t ws;
+static atomic_ulong stolen;
+static atomic_int stop;
+
+void *ws_thief(void *arg) {
+	long v;
+	int ok;
+	(void)arg;
+	while (!atomic_load(&stop)) {
+		dcarr_ws_steal(ws, ws_t, v, ok);
+		if (ok)
+			atomic_fetch_add(&stolen, (unsigned long)v);
+		else
+			sched_yield();
+	}
+	return NULL;
+}
+
+/* The owner pops the newest, thieves steal the oldest */
+void test_ws(void) {
+	pthread_t t[NTHREADS];
+	unsigned long expect = (unsigned long)NITEMS * (NITEMS + 1) / 2;
+	long w, mine;
+	int k, ok;
+
+	dcarr_ws_init(ws, ws_t, 4);
+	for (w = 0; w < 100; w++)
+		dcarr_ws_push(ws, ws_t, w);
+	dcarr_ws_steal(ws, ws_t, w, ok);
+	check(ok && w == 0);
+	dcarr_ws_pop(ws, long, w, ok);
+	check(ok && w == 99);
+	for (k = 1; k < 99; k++)
+		dcarr_ws_pop(ws, long, w, ok);
+	check(ok && w == 1);
+	dcarr_ws_pop(ws, long, w, ok);
+	check(!ok);
+	dcarr_ws_reclaim(ws, ok);
+	check(ok);
+
+	atomic_store(&stolen, 0);
+	atomic_store(&stop, 0);
+	for (k = 0; k < NTHREADS; k++)
+		pthread_create(&t[k], NULL, ws_thief, NULL);
+	mine = 0;
+	for (w = 1; w <= NITEMS; w++) {
+		dcarr_ws_push(ws, ws_t, w);
+		if (w % 3 == 0) {
+			long x;
+			dcarr_ws_pop(ws, long, x, ok);
+			if (ok)
+				mine += x;
+		}
+	}
+	do {
+		dcarr_ws_pop(ws, long, w, ok);
+		if (ok)
+			mine += w;
+	} while (ok);
+	/* the thieves take what is left, if anything */
+	while (atomic_load(&stolen) + (unsigned long)mine != expect &&
+	       atomic_load(&ws.top) < atomic_load(&ws.bottom))
+		sched_yield();
+	atomic_store(&stop, 1);
+	for (k = 0; k < NTHREADS; k++)
+		pthread_join(t[k], NULL);
+	check(atomic_load(&stolen) + (unsigned long)mine == expect);
+	dcarr_ws_destroy(ws);
+}
+
+#endif /* DCARR_ATOMICS */
+
+/* the address is a multiple of n */
+#define is_aligned(p, n) ((size_t)(p) % (n) == 0)
+
+/* The buffer stays aligned when growing and shrinking */
+void test_aligned(void) {
+	intarray_t a;
+	unsigned int i;
+	int v;
+
+	dcarr_init_aligned(a, 64);
+	for (i = 0; i < 5000; i++) {
+		if (i % 3 == 0)
+			dcarr_unshift(a, int, (int)i);
+		else
+			dcarr_push(a, int, (int)i);
+		check(is_aligned(a.els, 64));
+	}
+	while (dcarr_len(a) > 0) {
+		dcarr_pop(a, int, v);
+		check(a.els == NULL || is_aligned(a.els, 64));
+	}
+	(void)v;
+	dcarr_destroy(a);
+
+	dcarr_init_aligned(a, 64);
+	test_ops(&a);
+}
+
+dcarr_seg_define_type(segarray_t, int);
+
+/* The reference is kept in the middle of a C array */
+void test_seg(void) {
+	static int ref[2 * MAXLEN];
+	segarray_t a;
+	unsigned int lo = MAXLEN, hi = MAXLEN, i, op, pinned = 0;
+	int v, *pin = NULL;
+
+	dcarr_seg_init(a);
+	for (op = 0; op < 100000; op++) {
+		switch (hi == lo ? rnd(2) : rnd(4)) {
+		case 0:
+			if (hi == 2 * MAXLEN) break;
+			dcarr_seg_push(a, int, (int)op);
+			ref[hi++] = (int)op;
+			break;
+		case 1:
+			if (lo == 0) break;
+			dcarr_seg_unshift(a, int, (int)op);
+			ref[--lo] = (int)op;
+			break;
+		case 2:
+			dcarr_seg_pop(a, int, v);
+			check(v == ref[--hi]);
+			break;
+		case 3:
+			dcarr_seg_shift(a, int, v);
+			check(v == ref[lo++]);
+			break;
+		}
+		/* an element doesn't move while it is there */
+		if (pin && (pinned < lo || pinned >= hi))
+			pin = NULL;
+		if (pin)
+			check(pin == &dcarr_seg_elem(a, pinned - lo));
+		else if (hi > lo) {
+			pinned = lo + rnd(hi - lo);
+			pin = &dcarr_seg_elem(a, pinned - lo);
+		}
+		if (op % 101 == 0) {
+			check(dcarr_len(a) == hi - lo);
+			for (i = 0; i < hi - lo; i++)
+				check(dcarr_seg_elem(a, i) == ref[lo + i]);
+		}
+	}
+	dcarr_seg_destroy(a);
+}
+
+dcarr_tier_define_type(tierarray_t, int, 16);
+
+/* Insertions and removals anywhere, against memmove */
+void test_tier(void) {
+	static int ref[MAXLEN];
+	tierarray_t t;
+	unsigned int n = 0, i, op;
+	int v;
+
+	dcarr_tier_init(t);
+	for (op = 0; op < 60000; op++) {
+		switch (n == 0 ? 0 : rnd(5)) {
+		case 0:
+		case 1:
+			if (n == MAXLEN) break;
+			i = rnd(n + 1);
+			dcarr_tier_insert(t, i, tierarray_t, (int)op);
+			memmove(ref + i + 1, ref + i, (n - i) * sizeof(int));
+			ref[i] = (int)op;
+			n++;
+			break;
+		case 2:
+		case 3:
+			i = rnd(n);
+			dcarr_tier_remove(t, i, tierarray_t, v);
+			check(v == ref[i]);
+			memmove(ref + i, ref + i + 1, (n - i - 1) * sizeof(int));
+			n--;
+			break;
+		case 4:
+			if (rnd(2) && n < MAXLEN) {
+				dcarr_tier_push(t, tierarray_t, (int)op);
+				ref[n++] = (int)op;
+			} else {
+				dcarr_tier_pop(t, tierarray_t, v);
+				check(v == ref[--n]);
+			}
+			break;
+		}
+		check(t.len == n);
+		if (op % 53 == 0)
+			for (i = 0; i < n; i++)
+				check(dcarr_tier_elem(t, i) == ref[i]);
+	}
+	dcarr_tier_destroy(t);
+}
+
+dcarr_gap_define_type(gaparray_t, int);
+
+/* Edits mostly at a cursor, which sometimes jumps, against memmove */
+void test_gap(void) {
+	static int ref[MAXLEN];
+	gaparray_t g;
+	unsigned int n = 0, i, op, cursor = 0;
+	int v;
+
+	dcarr_gap_init(g);
+	for (op = 0; op < 60000; op++) {
+		if (rnd(20) == 0)
+			cursor = rnd(n + 1);
+		switch (n == 0 ? 0 : rnd(5)) {
+		case 0:
+		case 1:
+			if (n == MAXLEN) break;
+			i = rnd(4) ? cursor : rnd(n + 1);
+			dcarr_gap_insert(g, i, int, (int)op);
+			memmove(ref + i + 1, ref + i, (n - i) * sizeof(int));
+			ref[i] = (int)op;
+			n++;
+			cursor = i + 1;
+			break;
+		case 2:
+		case 3:
+			i = rnd(4) ? (cursor ? cursor - 1 : 0) : rnd(n);
+			dcarr_gap_remove(g, i, int, v);
+			check(v == ref[i]);
+			memmove(ref + i, ref + i + 1, (n - i - 1) * sizeof(int));
+			n--;
+			cursor = i;
+			break;
+		case 4:
+			cursor = rnd(n + 1);
+			dcarr_gap_move(g, int, cursor);
+			break;
+		}
+		check(g.len == n);
+		if (op % 53 == 0)
+			for (i = 0; i < n; i++)
+				check(dcarr_gap_elem(g, i) == ref[i]);
+	}
+	dcarr_gap_destroy(g);
+}
+
+#define int_less(x, y) ((x) < (y))
+
+/* Binary, 4-ary and 3-ary heaps, pushed or heapified, against qsort */
+void test_heap(void) {
+	static int ref[MAXLEN];
+	intarray_t a, b;
+	unsigned int n, i, d, round;
+	int v, w;
+
+	for (round = 0; round < 60; round++) {
+		n = rnd(2000);
+		d = 2 + round % 3;
+		dcarr_init(a);
+		fill(&b, ref, 0, rnd(100));
+		for (i = 0; i < n; i++) {
+			ref[i] = (int)rnd(500);
+			if (d == 2)
+				dcarr_heap_push(a, int, ref[i], int_less);
+			else if (d == 4)
+				dcarr_heap4_push(a, int, ref[i], int_less);
+			else
+				dcarr_heap_push_d(a, int, 3, ref[i], int_less);
+			dcarr_push(b, int, ref[i]);
+		}
+		if (d == 2)
+			dcarr_heapify(b, int, int_less);
+		else if (d == 4)
+			dcarr_heapify4(b, int, int_less);
+		else
+			dcarr_heapify_d(b, int, 3, int_less);
+		qsort(ref, n, sizeof(int), int_cmp);
+		for (i = 0; i < n; i++) {
+			if (d == 2) {
+				dcarr_heap_pop(a, int, v, int_less);
+				dcarr_heap_pop(b, int, w, int_less);
+			} else if (d == 4) {
+				dcarr_heap4_pop(a, int, v, int_less);
+				dcarr_heap4_pop(b, int, w, int_less);
+			} else {
+				dcarr_heap_pop_d(a, int, 3, v, int_less);
+				dcarr_heap_pop_d(b, int, 3, w, int_less);
+			}
+			check(v == ref[i] && w == ref[i]);
+		}
+		dcarr_destroy(a);
+		dcarr_destroy(b);
+	}
+}
+
+dcarr_window_define_type(window_t, int);
+
+/* Sliding window minimum and maximum against rescanning */
+void test_window(void) {
+	static int x[5000];
+	window_t mn, mx;
+	unsigned int size, i, j;
+	int lo, hi, rmin, rmax;
+
+	for (size = 0; size < 200; size += 1 + size / 2) {
+		dcarr_window_init(mn, size);
+		dcarr_window_init(mx, size);
+		for (i = 0; i < 5000; i++) {
+			x[i] = (int)rnd(1000);
+			dcarr_window_min(mn, window_t, x[i], rmin);
+			dcarr_window_max(mx, window_t, x[i], rmax);
+			lo = hi = x[i];
+			/* a size of 0 is taken as 1 */
+			for (j = 1; j < size && j <= i; j++) {
+				if (x[i - j] < lo) lo = x[i - j];
+				if (x[i - j] > hi) hi = x[i - j];
+			}
+			check(rmin == lo && rmax == hi);
+			check(dcarr_window_value(mn) == lo);
+		}
+		dcarr_window_destroy(mn);
+		dcarr_window_destroy(mx);
+	}
+}
+
+/* Overwriting and rejecting, against a reference deque */
+void test_bounded(void) {
+	static int ref[2 * MAXLEN];
+	intarray_t b;
+	unsigned int lo, hi, i, op;
+	int v, ok;
+
+	dcarr_bounded_init(b, int, 10);
+	for (op = 0; op < 100; op++)
+		dcarr_bounded_push(b, int, (int)op);
+	check(dcarr_len(b) == 16);
+	for (i = 0; i < 16; i++)
+		check(dcarr_elem(b, i) == 84 + (int)i);
+	dcarr_bounded_try_push(b, int, 0, ok);
+	check(!ok);
+	dcarr_destroy(b);
+
+	dcarr_bounded_init(b, int, 16);
+	lo = hi = MAXLEN;
+	for (op = 0; op < 20000; op++) {
+		switch (hi == lo ? 0 : rnd(3)) {
+		case 0:
+			dcarr_bounded_try_push(b, int, (int)op, ok);
+			check(ok == (hi - lo < 16));
+			if (ok)
+				ref[hi++] = (int)op;
+			break;
+		case 1:
+			dcarr_bounded_pop(b, int, v);
+			check(v == ref[--hi]);
+			break;
+		case 2:
+			dcarr_bounded_shift(b, int, v);
+			check(v == ref[lo++]);
+			break;
+		}
+		if (hi > 2 * MAXLEN - 16) {
+			memmove(ref + MAXLEN, ref + lo, (hi - lo) * sizeof(int));
+			hi = MAXLEN + hi - lo;
+			lo = MAXLEN;
+		}
+		check(dcarr_len(b) == hi - lo && b.cap == 16);
+		for (i = 0; i < hi - lo; i++)
+			check(dcarr_elem(b, i) == ref[lo + i]);
+	}
+	dcarr_destroy(b);
+}
+
+dcarr_define_fixed_type(fixedarray_t, int, 16);
+
+/* Against a reference deque */
+void test_fixed(void) {
+	static int ref[2 * MAXLEN];
+	fixedarray_t f;
+	unsigned int lo, hi, i, op;
+	int v;
+
+	dcarr_fixed_init(f);
+	check(dcarr_fixed_cap(f) == 16);
+	lo = hi = MAXLEN;
+	for (op = 0; op < 20000; op++) {
+		switch (hi == lo ? rnd(2) : hi - lo == 16 ? 2 + rnd(2) : rnd(4)) {
+		case 0:
+			dcarr_fixed_push(f, int, (int)op);
+			ref[hi++] = (int)op;
+			break;
+		case 1:
+			dcarr_fixed_unshift(f, int, (int)op);
+			ref[--lo] = (int)op;
+			break;
+		case 2:
+			dcarr_fixed_pop(f, int, v);
+			check(v == ref[--hi]);
+			break;
+		case 3:
+			dcarr_fixed_shift(f, int, v);
+			check(v == ref[lo++]);
+			break;
+		}
+		if (lo < 16 || hi > 2 * MAXLEN - 16) {
+			memmove(ref + MAXLEN, ref + lo, (hi - lo) * sizeof(int));
+			hi = MAXLEN + hi - lo;
+			lo = MAXLEN;
+		}
+		check(dcarr_len(f) == hi - lo);
+		check(dcarr_fixed_full(f) == (hi - lo == 16));
+		for (i = 0; i < hi - lo; i++)
+			check(dcarr_fixed_elem(f, i) == ref[lo + i]);
+	}
+}
+
+/* append, prepend and split_off, with wrapped content */
+void test_append(void) {
+	static int ra[200], rb[100], rc[300];
+	intarray_t a, b;
+	unsigned int na, nb, i;
+
+	for (i = 0; i < 200; i++)
+		ra[i] = (int)i;
+	for (i = 0; i < 100; i++)
+		rb[i] = 1000 + (int)i;
+	for (na = 0; na < 100; na += 7)
+		for (nb = 0; nb < 60; nb += 11) {
+			/* append and split it back */
+			fill(&a, ra, na, rnd(40));
+			fill(&b, rb, nb, rnd(40));
+			dcarr_append(a, b, int);
+			check(dcarr_len(b) == 0);
+			memcpy(rc, ra, na * sizeof(int));
+			memcpy(rc + na, rb, nb * sizeof(int));
+			check(same(&a, rc, na + nb));
+			dcarr_split_off(a, na, b, int);
+			check(same(&a, ra, na) && same(&b, rb, nb));
+			dcarr_prepend(a, b, int);
+			memcpy(rc, rb, nb * sizeof(int));
+			memcpy(rc + nb, ra, na * sizeof(int));
+			check(same(&a, rc, na + nb) && dcarr_len(b) == 0);
+			dcarr_destroy(a);
+			dcarr_destroy(b);
+		}
+}
+
+/* The four transfers, with wrapped content */
+void test_transfer(void) {
+	static int ra[200], rb[100], rc[300];
+	intarray_t a, c;
+	unsigned int na, nb, n, i, mode;
+
+	for (i = 0; i < 200; i++)
+		ra[i] = (int)i;
+	for (i = 0; i < 100; i++)
+		rb[i] = 1000 + (int)i;
+	for (na = 0; na < 100; na += 7)
+		for (nb = 0; nb < 60; nb += 11)
+			for (mode = 0; mode < 4; mode++) {
+				n = rnd(nb + 1);
+				fill(&a, ra, na, rnd(40));
+				fill(&c, rb, nb, rnd(40));
+				switch (mode) {
+				case 0:
+					dcarr_transfer_front_to_back(a, c, n, int);
+					memcpy(rc, ra, na * sizeof(int));
+					memcpy(rc + na, rb, n * sizeof(int));
+					break;
+				case 1:
+					dcarr_transfer_front_to_front(a, c, n, int);
+					memcpy(rc, rb, n * sizeof(int));
+					memcpy(rc + n, ra, na * sizeof(int));
+					break;
+				case 2:
+					dcarr_transfer_back_to_back(a, c, n, int);
+					memcpy(rc, ra, na * sizeof(int));
+					memcpy(rc + na, rb + nb - n, n * sizeof(int));
+					break;
+				case 3:
+					dcarr_transfer_back_to_front(a, c, n, int);
+					memcpy(rc, rb + nb - n, n * sizeof(int));
+					memcpy(rc + n, ra, na * sizeof(int));
+					break;
+				}
+				check(same(&a, rc, na + n));
+				check(same(&c, rb + (mode < 2 ? n : 0), nb - n));
+				dcarr_destroy(a);
+				dcarr_destroy(c);
+			}
+}
+
+#define is_even(x) ((x) % 2 == 0)
+
+/* At lengths around the block sizes of the vectorized loops */
+void test_find(void) {
+	static int ref[1000];
+	intarray_t a;
+	unsigned int n, i, k, idx, count, ei, ec;
+	int found, v;
+
+	for (n = 0; n < 300; n += 1 + n / 8) {
+		for (i = 0; i < n; i++)
+			ref[i] = (int)rnd(100) - 50;
+		fill(&a, ref, n, rnd(200));
+		for (k = 0; k < 20; k++) {
+			v = (int)rnd(110) - 55;
+			ei = n;
+			ec = 0;
+			for (i = n; i-- > 0;)
+				if (ref[i] == v) {
+					ei = i;
+					ec++;
+				}
+			dcarr_find(a, int, v, idx);
+			dcarr_count(a, int, v, count);
+			dcarr_contains(a, int, v, found);
+			check(idx == ei && count == ec && found == (ec > 0));
+		}
+		ei = n;
+		for (i = n; i-- > 0;)
+			if (is_even(ref[i]))
+				ei = i;
+		dcarr_find_if(a, int, is_even, idx);
+		check(idx == ei);
+		dcarr_destroy(a);
+	}
+}
+
+dcarr_define_type(doublearray_t, double);
+
+/* At lengths around the block sizes of the vectorized loops */
+void test_reduce(void) {
+	static int ref[1000];
+	intarray_t a;
+	doublearray_t d;
+	unsigned int n, i;
+	int mn, mx, v, w;
+	long sum, esum;
+	double ds;
+
+	for (n = 1; n < 300; n += 1 + n / 8) {
+		for (i = 0; i < n; i++)
+			ref[i] = (int)rnd(10000) - 5000;
+		fill(&a, ref, n, rnd(200));
+		esum = 0;
+		mn = mx = ref[0];
+		for (i = 0; i < n; i++) {
+			esum += ref[i];
+			if (ref[i] < mn) mn = ref[i];
+			if (ref[i] > mx) mx = ref[i];
+		}
+		dcarr_sum(a, int, long, sum);
+		check(sum == esum);
+		dcarr_min(a, int, v);
+		dcarr_max(a, int, w);
+		check(v == mn && w == mx);
+		dcarr_minmax(a, int, v, w);
+		check(v == mn && w == mx);
+		dcarr_destroy(a);
+	}
+
+	/* the compensated sum keeps the small terms */
+	dcarr_init(d);
+	dcarr_push(d, double, 1e100);
+	for (i = 0; i < 1000; i++)
+		dcarr_push(d, double, 1.0);
+	dcarr_push(d, double, -1e100);
+	dcarr_sum_compensated(d, double, double, ds);
+	check(ds == 1000.0);
+	dcarr_destroy(d);
+}
+
+#define is_odd(x) ((x) % 2 != 0)
+
+void test_retain(void) {
+	static int ref[1000];
+	intarray_t a;
+	unsigned int n, m, i, k;
+
+	for (n = 0; n < 300; n += 1 + n / 8) {
+		for (i = 0; i < n; i++)
+			ref[i] = (int)rnd(20);
+		fill(&a, ref, n, rnd(200));
+		dcarr_retain_if(a, int, is_odd);
+		for (i = k = 0; i < n; i++)
+			if (is_odd(ref[i]))
+				ref[k++] = ref[i];
+		check(same(&a, ref, k));
+		dcarr_sort(a, int, int_cmp);
+		qsort(ref, k, sizeof(int), int_cmp);
+		dcarr_dedup_adjacent(a, int);
+		for (i = m = 0; i < k; i++)
+			if (i == 0 || ref[i] != ref[i - 1])
+				ref[m++] = ref[i];
+		check(same(&a, ref, m));
+		dcarr_destroy(a);
+	}
+}
+
+/* Binary search in an array built by insert_sorted */
+void test_bounds(void) {
+	static int ref[1000];
+	intarray_t a;
+	unsigned int n, i, lb, ub, elb, eub;
+	int v;
+
+	for (n = 0; n < 300; n += 1 + n / 4) {
+		fill(&a, ref, 0, rnd(100));
+		for (i = 0; i < n; i++) {
+			ref[i] = (int)rnd(40);
+			dcarr_insert_sorted(a, int, ref[i], int_less);
+		}
+		qsort(ref, n, sizeof(int), int_cmp);
+		check(same(&a, ref, n));
+		for (v = -1; v <= 41; v++) {
+			for (elb = 0; elb < n && ref[elb] < v; elb++);
+			for (eub = elb; eub < n && ref[eub] == v; eub++);
+			dcarr_lower_bound(a, int, v, int_less, lb);
+			dcarr_upper_bound(a, int, v, int_less, ub);
+			check(lb == elb && ub == eub);
+		}
+		dcarr_destroy(a);
+	}
+}
+
+typedef struct { int key; int seq; } pair_t;
+dcarr_define_type(pairarray_t, pair_t);
+
+/* Evicting the oldest of events with two per time step */
+void test_evict(void) {
+	pairarray_t p;
+	pair_t e = {0, 0};
+	unsigned int n, i, k, gone;
+	int t;
+
+	for (n = 0; n < 200; n += 9)
+		for (t = -1; t < (int)n / 2 + 2; t += 3) {
+			dcarr_init(p);
+			for (k = rnd(70); k > 0; k--)
+				dcarr_push(p, pair_t, e);
+			while (dcarr_len(p) > 0)
+				dcarr_shift(p, pair_t, e);
+			for (i = 0; i < n; i++) {
+				e.key = (int)i / 2;
+				e.seq = (int)i;
+				dcarr_push(p, pair_t, e);
+			}
+			dcarr_evict_front_while_less(p, pair_t, key, t);
+			gone = t <= 0 ? 0 : 2 * (unsigned int)t < n ? 2 * (unsigned int)t : n;
+			check(dcarr_len(p) == n - gone);
+			for (i = 0; i < dcarr_len(p); i++)
+				check(dcarr_elem(p, i).seq == (int)(gone + i));
+			dcarr_destroy(p);
+		}
+}
+
+#define pair_less(x, y) ((x).key < (y).key)
+
+/* Returns 1 if the pairs are sorted by key and then by seq */
+int pairs_sorted(pairarray_t *p) {
+	unsigned int i;
+	for (i = 1; i < dcarr_len(*p); i++) {
+		pair_t x = dcarr_elem(*p, i - 1), y = dcarr_elem(*p, i);
+		if (x.key > y.key || (x.key == y.key && x.seq > y.seq))
+			return 0;
+	}
+	return 1;
+}
+
+/*
+ * Fills p with n pairs, numbered in seq, with random, nearly sorted or
+ * reversed keys.
+ */
+void fill_pairs(pairarray_t *p, unsigned int n, unsigned int kind) {
+	pair_t e = {0, 0};
+	unsigned int i;
+	dcarr_init(*p);
+	for (i = rnd(50); i > 0; i--)
+		dcarr_unshift(*p, pair_t, e);
+	while (dcarr_len(*p) > 0)
+		dcarr_pop(*p, pair_t, e);
+	for (i = 0; i < n; i++) {
+		e.key = kind == 0 ? (int)rnd(20) :
+		        kind == 1 ? (int)(i / 3 + rnd(2)) : (int)(n - i);
+		e.seq = (int)i;
+		dcarr_push(*p, pair_t, e);
+	}
+}
+
+/* Stable sort and k-way merge, equal keys kept in order */
+void test_stable_sort(void) {
+	pairarray_t p, scratch, srcs[6], out;
+	pair_t e;
+	unsigned int n, i, k, s, total, round;
+
+	dcarr_init(scratch);
+	for (round = 0; round < 40; round++) {
+		n = rnd(round < 20 ? 100 : 3000);
+		fill_pairs(&p, n, round % 3);
+		dcarr_stable_sort(p, pair_t, pair_less, scratch);
+		check(dcarr_len(p) == n && pairs_sorted(&p));
+		dcarr_destroy(p);
+	}
+	dcarr_destroy(scratch);
+
+	/* equal keys are taken from the lower numbered source first */
+	for (k = 0; k <= 6; k++) {
+		total = 0;
+		for (s = 0; s < k; s++) {
+			dcarr_init(srcs[s]);
+			e.key = 0;
+			for (i = rnd(60); i > 0; i--) {
+				e.key += (int)rnd(3);
+				e.seq = (int)total++;
+				dcarr_push(srcs[s], pair_t, e);
+			}
+		}
+		dcarr_init(out);
+		dcarr_merge(out, srcs, k, pair_t, pair_less);
+		check(dcarr_len(out) == total && pairs_sorted(&out));
+		for (s = 0; s < k; s++)
+			dcarr_destroy(srcs[s]);
+		dcarr_destroy(out);
+	}
+}
+
+/* nth_element, partial_sort and top_k against qsort */
+void test_select(void) {
+	static int ref[3000];
+	intarray_t a, top;
+	unsigned int n, i, k, round;
+
+	for (round = 0; round < 300; round++) {
+		n = rnd(round % 10 ? 300 : 3000);
+		for (i = 0; i < n; i++)
+			ref[i] = (int)rnd(round % 3 ? 1000 : 4);
+		fill(&a, ref, n, rnd(200));
+		qsort(ref, n, sizeof(int), int_cmp);
+		k = rnd(n + 3);
+		switch (round % 3) {
+		case 0:
+			if (n == 0) break;
+			k %= n;
+			dcarr_nth_element(a, int, k, int_less);
+			check(dcarr_elem(a, k) == ref[k]);
+			for (i = 0; i < n; i++)
+				check(i < k ? dcarr_elem(a, i) <= ref[k] :
+				              dcarr_elem(a, i) >= ref[k]);
+			break;
+		case 1:
+			dcarr_partial_sort(a, int, k, int_less);
+			for (i = 0; i < k && i < n; i++)
+				check(dcarr_elem(a, i) == ref[i]);
+			break;
+		case 2:
+			dcarr_init(top);
+			dcarr_top_k(a, int, k, int_less, top);
+			check(dcarr_len(top) == (k < n ? k : n));
+			for (i = 0; i < dcarr_len(top); i++)
+				check(dcarr_elem(top, i) == ref[n - 1 - i]);
+			dcarr_destroy(top);
+			break;
+		}
+		check(dcarr_len(a) == n);
+		dcarr_destroy(a);
+	}
+}
+
+dcarr_define_type(uintarray_t, unsigned int);
+
+/* Both are stable, so they agree with each other */
+void test_argsort(void) {
+	pairarray_t p, q;
+	uintarray_t idx;
+	unsigned int n, i, round;
+
+	for (round = 0; round < 40; round++) {
+		n = rnd(round < 20 ? 100 : 3000);
+		fill_pairs(&p, n, round % 3);
+		dcarr_init(q);
+		for (i = 0; i < n; i++)
+			dcarr_push(q, pair_t, dcarr_elem(p, i));
+		dcarr_init(idx);
+		dcarr_push(idx, unsigned int, 7u);
+		dcarr_argsort(p, pair_less, idx);
+		check(dcarr_len(idx) == n);
+		dcarr_sort_by_key(q, pair_t, int, key, int_less);
+		check(pairs_sorted(&q));
+		for (i = 0; i < dcarr_len(idx) && i < n; i++)
+			check(dcarr_elem(p, dcarr_elem(idx, i)).seq ==
+			      dcarr_elem(q, i).seq);
+		dcarr_destroy(p);
+		dcarr_destroy(q);
+		dcarr_destroy(idx);
+	}
+}
+
+/* Returns 1 if the sorted array a contains x */
+int has(intarray_t *a, int x) {
+	unsigned int i;
+	for (i = 0; i < dcarr_len(*a) && dcarr_elem(*a, i) <= x; i++)
+		if (dcarr_elem(*a, i) == x)
+			return 1;
+	return 0;
+}
+
+/* Set operations, including on very different lengths */
+void test_sets(void) {
+	static int ra[MAXLEN], rb[MAXLEN], rc[2 * MAXLEN];
+	intarray_t a, b, d;
+	unsigned int na, nb, nc, i, j, round;
+	int x;
+
+	for (round = 0; round < 400; round++) {
+		na = rnd(round % 2 ? MAXLEN : 60);
+		nb = rnd(round % 3 ? 60 : MAXLEN);
+		for (i = 0, x = 0; i < na; i++)
+			ra[i] = x += 1 + (int)rnd(3);
+		for (i = 0, x = 0; i < nb; i++)
+			rb[i] = x += 1 + (int)rnd(3);
+		fill(&a, ra, na, rnd(100));
+		fill(&b, rb, nb, rnd(100));
+		/* the destination's old content is replaced */
+		dcarr_init(d);
+		dcarr_push(d, int, 42);
+
+		dcarr_set_intersect(a, b, int, d);
+		for (i = nc = 0; i < na; i++)
+			if (has(&b, ra[i]))
+				rc[nc++] = ra[i];
+		check(same(&d, rc, nc));
+
+		dcarr_set_difference(a, b, int, d);
+		for (i = nc = 0; i < na; i++)
+			if (!has(&b, ra[i]))
+				rc[nc++] = ra[i];
+		check(same(&d, rc, nc));
+
+		dcarr_set_union(a, b, int, d);
+		for (i = j = nc = 0; i < na || j < nb;)
+			if (j == nb || (i < na && ra[i] < rb[j]))
+				rc[nc++] = ra[i++];
+			else if (i == na || rb[j] < ra[i])
+				rc[nc++] = rb[j++];
+			else {
+				rc[nc++] = ra[i++];
+				j++;
+			}
+		check(same(&d, rc, nc));
+
+		dcarr_destroy(a);
+		dcarr_destroy(b);
+		dcarr_destroy(d);
+	}
+}
+
+/* gather, scatter and permute */
+void test_gather(void) {
+	static int ref[1000], buf[1000];
+	static unsigned int idx[1000], perm[1000];
+	intarray_t a;
+	uintarray_t order;
+	unsigned int n, m, i, j, last, round;
+
+	for (round = 0; round < 200; round++) {
+		n = 1 + rnd(1000);
+		m = rnd(200);
+		for (i = 0; i < n; i++)
+			ref[i] = (int)rnd(10000);
+		fill(&a, ref, n, rnd(500));
+
+		for (i = 0; i < m; i++)
+			idx[i] = rnd(n);
+		dcarr_gather(a, idx, m, buf);
+		for (i = 0; i < m; i++)
+			check(buf[i] == ref[idx[i]]);
+		for (i = 0; i < m; i++)
+			buf[i] = -(int)i;
+		dcarr_scatter(a, idx, m, buf);
+		for (i = 0; i < n; i++) {
+			for (last = m, j = 0; j < m; j++)
+				if (idx[j] == i)
+					last = j;
+			check(dcarr_elem(a, i) == (last < m ? -(int)last : ref[i]));
+			ref[i] = dcarr_elem(a, i);
+		}
+
+		/* a random permutation, which must be left as it was */
+		for (i = 0; i < n; i++)
+			perm[i] = i;
+		for (i = n; i > 1; i--) {
+			j = rnd(i);
+			last = perm[i - 1];
+			perm[i - 1] = perm[j];
+			perm[j] = last;
+		}
+		memcpy(idx, perm, n * sizeof(unsigned int));
+		dcarr_permute(a, int, perm);
+		check(memcmp(idx, perm, n * sizeof(unsigned int)) == 0);
+		for (i = 0; i < n; i++)
+			check(dcarr_elem(a, i) == ref[perm[i]]);
+
+		/* argsort and permute is a sort */
+		dcarr_init(order);
+		dcarr_argsort(a, int_less, order);
+		dcarr_permute(a, int, order.els);
+		qsort(ref, n, sizeof(int), int_cmp);
+		check(same(&a, ref, n));
+		dcarr_destroy(order);
+		dcarr_destroy(a);
+	}
+}
+
+/* Runs the tests of each family in turn */
+int main() {
+	printf("basic\n");
+	test_basic();
+#ifdef DCARR_STATS
+	printf("stats\n");
+	test_stats();
+#endif
+	printf("inc\n");
+	test_inc();
+#ifdef DCARR_ATOMICS
+	printf("spsc\n");
+	test_spsc();
+	printf("mpmc\n");
+	test_mpmc();
+	printf("ws\n");
+	test_ws();
+#endif
+	printf("aligned\n");
+	test_aligned();
+	printf("seg\n");
+	test_seg();
+	printf("tier\n");
+	test_tier();
+	printf("gap\n");
+	test_gap();
+	printf("heap\n");
+	test_heap();
+	printf("window\n");
+	test_window();
+	printf("bounded\n");
+	test_bounded();
+	printf("fixed\n");
+	test_fixed();
+	printf("append\n");
+	test_append();
+	printf("transfer\n");
+	test_transfer();
+	printf("find\n");
+	test_find();
+	printf("reduce\n");
+	test_reduce();
+	printf("retain\n");
+	test_retain();
+	printf("bounds\n");
+	test_bounds();
+	printf("evict\n");
+	test_evict();
+	printf("stable sort\n");
+	test_stable_sort();
+	printf("select\n");
+	test_select();
+	printf("argsort\n");
+	test_argsort();
+	printf("sets\n");
+	test_sets();
+	printf("gather\n");
+	test_gather();
+	printf("%s\n", failures ? "FAILED" : "ok");
+	return failures ? 1 : 0;
+}
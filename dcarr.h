@@ -17,9 +17,98 @@
 #define dcarr_realloc realloc
 #define dcarr_free    free
 #define dcarr_oom()   exit(-1)
+#define dcarr_inc_batch 4 /* elements migrated per incremental operation */
+#define dcarr_cacheline 64 /* keeps concurrently written fields apart */
+#define dcarr_seg_chunk 64 /* elements per chunk in segmented arrays, 2^n */
+#define dcarr_lanes 8 /* accumulators in searches and reductions */
+#define dcarr_gather_ahead 16 /* elements prefetched ahead by gather/scatter */
 
 #include <string.h> /* memmove, memset */
 
+/*
+ * Sets the void pointer p to size bytes aligned to align, or to NULL,
+ * for arrays initialized using dcarr_init_aligned. C11 has aligned_alloc
+ * and POSIX has posix_memalign. Without either, dcarr_init_aligned
+ * doesn't compile. Redefine to use another aligned allocator.
+ */
+#if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+#define dcarr_aligned_alloc(p, align, size) \
+	((p) = aligned_alloc((align), (size)))
+#elif defined(_POSIX_C_SOURCE) && _POSIX_C_SOURCE >= 200112L
+#define dcarr_aligned_alloc(p, align, size) do{ \
+	void *_ap; \
+	(p) = posix_memalign(&_ap, (align) < sizeof(void *) ? sizeof(void *) \
+	                     : (align), (size)) ? NULL : _ap; \
+}while(0)
+#else
+#define dcarr_aligned_alloc(p, align, size) ((p) = NULL)
+#define dcarr_no_aligned_alloc
+#endif
+
+#if defined(__GNUC__)
+#define dcarr_prefetch(p) __builtin_prefetch(p)
+#else
+#define dcarr_prefetch(p) ((void)0)
+#endif
+
+/*
+ * A struct member declaration which fails to compile unless n is a power
+ * of 2, using _Static_assert in C11 and else a bit-field of negative
+ * width. Unlike a typedef, it causes no unused warnings at block scope.
+ * (Used internally.)
+ */
+#if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+#define dcarr_assert_pow2_member(n) \
+	_Static_assert((n) > 0 && ((n) & ((n) - 1)) == 0, \
+	               #n " must be a power of 2");
+#else
+#define dcarr_assert_pow2_member(n) \
+	unsigned int : (n) > 0 && ((n) & ((n) - 1)) == 0 ? 0 : -1;
+#endif
+
+/* keeps -O3 from unrolling a loop before it is vectorized */
+#if defined(__GNUC__) && __GNUC__ >= 8
+#define dcarr_nounroll _Pragma("GCC unroll 1")
+#else
+#define dcarr_nounroll
+#endif
+
+/*
+ * Operation counters, enabled by compiling with -DDCARR_STATS.
+ *
+ * Each array then carries a dcarr_stats_t member, updated by the resizing
+ * and moving macros. Redefine dcarr_stat to route the events to your own
+ * counters instead. Without DCARR_STATS, all of this expands to nothing.
+ */
+#ifdef DCARR_STATS
+#include <stdio.h> /* fprintf */
+typedef struct dcarr_stats {
+	unsigned long reserves; /* calls to dcarr_reserve that grow */
+	unsigned long reallocs; /* calls to dcarr_realloc */
+	unsigned long moved;    /* bytes moved with memmove/memcpy */
+	unsigned long shrinks;  /* capacity reductions */
+	unsigned int peak_cap;  /* highest capacity seen */
+} dcarr_stats_t;
+#define dcarr_stats_member dcarr_stats_t stats;
+#define dcarr_stat(a, counter, n) ((a).stats.counter += (n))
+#define dcarr_stat_peak(a) do{ \
+	if ((a).cap > (a).stats.peak_cap) (a).stats.peak_cap = (a).cap; \
+}while(0)
+#define dcarr_stats_reset(a) \
+	memset(&(a).stats, 0, sizeof(dcarr_stats_t))
+/* Prints the counters of an array to the stdio stream fp. */
+#define dcarr_stats_dump(a, fp) \
+	fprintf((fp), "reserves=%lu reallocs=%lu moved=%lu shrinks=%lu " \
+	        "peak_cap=%u\n", (a).stats.reserves, (a).stats.reallocs, \
+	        (a).stats.moved, (a).stats.shrinks, (a).stats.peak_cap)
+#else
+#define dcarr_stats_member
+#define dcarr_stat(a, counter, n) ((void)0)
+#define dcarr_stat_peak(a) ((void)0)
+#define dcarr_stats_reset(a) ((void)0)
+#define dcarr_stats_dump(a, fp) ((void)0)
+#endif
+
 /*
  * Defines arraytype as an array with elements of type elemtype.
  *
@@ -31,6 +120,8 @@
 		unsigned int cap; \
 		unsigned int off; \
 		unsigned int len; \
+		unsigned int align; \
+		dcarr_stats_member \
 	} arraytype
 
 /*
@@ -44,7 +135,26 @@
 #define dcarr_init(a) do{\
 	(a).els = NULL; \
 	(a).cap = (a).off = (a).len = 0; \
+	(a).align = 0; \
+	dcarr_stats_reset(a); \
+}while(0)
+
+/*
+ * Initializes an array like dcarr_init, but the elements will be stored
+ * in memory aligned to alignment bytes, a power of 2. An alignment of the
+ * cache line size lets SIMD loads over the elements be aligned and keeps
+ * adjacent arrays from sharing cache lines.
+ */
+#ifndef dcarr_no_aligned_alloc
+#define dcarr_init_aligned(a, alignment) do{ \
+	dcarr_init(a); \
+	(a).align = (alignment); \
 }while(0)
+#else
+/* an undeclared identifier: compile with -std=c11 or a POSIX libc */
+#define dcarr_init_aligned(a, alignment) \
+	dcarr_init_aligned_needs_c11_or_posix_memalign
+#endif
 
 /*
  * Frees all allocated memory. To use the array again after this, it must
@@ -110,17 +220,20 @@
 	dcarr_reserve((a), elemtype, 1); \
 	if ((i) < (a).len) { \
 		/* need to move elements */ \
-		if (dcarr_idx(a, i) > (a).off && (a).off != 0) { \
+		if (dcarr_idx(a, i) >= (a).off && (a).off != 0) { \
 			/* move the beginning of the list backwards */ \
 			memmove(&((a).els[(a).off-1]), \
 			        &((a).els[(a).off]), \
 			        sizeof(elemtype) * (dcarr_idx(a, i) - (a).off)); \
+			dcarr_stat((a), moved, \
+			           sizeof(elemtype) * (dcarr_idx(a, i) - (a).off)); \
 			(a).off--; \
 		} else { \
 			/* move the end of the list forward */ \
 			memmove(&((a).els[dcarr_idx(a, i)+1]), \
 			        &((a).els[dcarr_idx(a, i)]), \
-			        sizeof(elemtype) * ((a).len - i)); \
+			        sizeof(elemtype) * ((a).len - (i))); \
+			dcarr_stat((a), moved, sizeof(elemtype) * ((a).len - (i))); \
 		} \
 	}\
 	(a).len++; \
@@ -136,6 +249,7 @@
 #define dcarr_resize(a, elemtype, newsize) do{ \
 	if ((newsize) > (a).len) {\
 		dcarr_reserve((a), elemtype, (newsize) - (a).len); \
+	} \
 	(a).len = (newsize); \
 	dcarr_reduce_size(a, elemtype); \
 }while(0)
@@ -144,16 +258,726 @@
  * Sort using a compare function of the type which qsort expects
  */
 #define dcarr_sort(a, elemtype, cmp) do{\
-	if ((a).off + (a).len > (a).cap) { \
-		/* it warps around. just move the parts together. */ \
-		memmove(&((a).els[(a).off + (a).len - (a).cap]), \
-		        &((a).els[(a).off]), \
-		        sizeof(elemtype) * ((a).cap - (a).off)); \
-		(a).off = 0; \
-	}\
+	dcarr_compact((a), elemtype); \
 	qsort(&((a).els[(a).off]), (a).len, sizeof(elemtype), (cmp)); \
 }while(0)
 
+/*
+ * Move all elements of src to the end of dst, leaving src empty. If dst
+ * is empty, src's buffer is taken over without copying. Otherwise they
+ * are copied using at most four memcpy and src's memory is freed.
+ */
+#define dcarr_append(dst, src, elemtype) do{ \
+	if ((dst).len == 0 && (dst).align <= (src).align) { \
+		dcarr_take((dst), (src)); \
+	} else { \
+		dcarr_reserve((dst), elemtype, (src).len); \
+		dcarr_copy_between((dst), (dst).len, (src), 0, (src).len, \
+		                   elemtype); \
+		(dst).len += (src).len; \
+		dcarr_free((src).els); \
+		(src).els = NULL; \
+		(src).cap = (src).off = (src).len = 0; \
+	} \
+}while(0)
+
+/*
+ * Move all elements of src to the beginning of dst, leaving src empty.
+ * Like dcarr_append, but the elements are inserted before dst's.
+ */
+#define dcarr_prepend(dst, src, elemtype) do{ \
+	if ((dst).len == 0 && (dst).align <= (src).align) { \
+		dcarr_take((dst), (src)); \
+	} else { \
+		dcarr_reserve((dst), elemtype, (src).len); \
+		(dst).off = dcarr_idx((dst), (dst).cap - (src).len); \
+		(dst).len += (src).len; \
+		dcarr_copy_between((dst), 0, (src), 0, (src).len, elemtype); \
+		dcarr_free((src).els); \
+		(src).els = NULL; \
+		(src).cap = (src).off = (src).len = 0; \
+	} \
+}while(0)
+
+/*
+ * Move the elements from index i to the end of a into out, which must be
+ * empty. If i is 0, out takes over a's buffer. Otherwise the elements are
+ * copied using at most two memcpy and a may shrink.
+ */
+#define dcarr_split_off(a, i, out, elemtype) do{ \
+	if ((i) == 0 && (out).align <= (a).align) { \
+		dcarr_take((out), (a)); \
+	} else { \
+		unsigned int _i = (i); \
+		dcarr_reserve((out), elemtype, (a).len - _i); \
+		(out).off = 0; \
+		(out).len = (a).len - _i; \
+		dcarr_copy_out((a), _i, (out).len, elemtype, (out).els); \
+		(a).len = _i; \
+		dcarr_reduce_size((a), elemtype); \
+	} \
+}while(0)
+
+/*
+ * Move n elements from one end of src to one end of dst, keeping their
+ * order. The elements are copied using at most four memcpy, dst is
+ * reserved once and src is shrunk at most once.
+ */
+#define dcarr_transfer_front_to_back(dst, src, n, elemtype) do{ \
+	unsigned int _tn = (n); \
+	dcarr_reserve((dst), elemtype, _tn); \
+	dcarr_copy_between((dst), (dst).len, (src), 0, _tn, elemtype); \
+	(dst).len += _tn; \
+	(src).off = dcarr_idx((src), _tn); \
+	(src).len -= _tn; \
+	dcarr_reduce_size((src), elemtype); \
+}while(0)
+
+#define dcarr_transfer_front_to_front(dst, src, n, elemtype) do{ \
+	unsigned int _tn = (n); \
+	dcarr_reserve((dst), elemtype, _tn); \
+	(dst).off = dcarr_idx((dst), (dst).cap - _tn); \
+	(dst).len += _tn; \
+	dcarr_copy_between((dst), 0, (src), 0, _tn, elemtype); \
+	(src).off = dcarr_idx((src), _tn); \
+	(src).len -= _tn; \
+	dcarr_reduce_size((src), elemtype); \
+}while(0)
+
+#define dcarr_transfer_back_to_back(dst, src, n, elemtype) do{ \
+	unsigned int _tn = (n); \
+	dcarr_reserve((dst), elemtype, _tn); \
+	dcarr_copy_between((dst), (dst).len, (src), (src).len - _tn, _tn, \
+	                   elemtype); \
+	(dst).len += _tn; \
+	(src).len -= _tn; \
+	dcarr_reduce_size((src), elemtype); \
+}while(0)
+
+#define dcarr_transfer_back_to_front(dst, src, n, elemtype) do{ \
+	unsigned int _tn = (n); \
+	dcarr_reserve((dst), elemtype, _tn); \
+	(dst).off = dcarr_idx((dst), (dst).cap - _tn); \
+	(dst).len += _tn; \
+	dcarr_copy_between((dst), 0, (src), (src).len - _tn, _tn, elemtype); \
+	(src).len -= _tn; \
+	dcarr_reduce_size((src), elemtype); \
+}while(0)
+
+/*
+ * Remove all elements at the beginning whose member key_field is less
+ * than threshold, O(log n). The elements must be structs ordered by
+ * key_field, such as timestamps. The cut point is found by binary search,
+ * then the prefix is dropped by moving the offset and the array is shrunk
+ * at most once.
+ */
+#define dcarr_evict_front_while_less(a, elemtype, key_field, threshold) do{ \
+	unsigned int _cut; \
+	dcarr_bsearch((a), \
+	              dcarr_elem((a), _b + _half).key_field < (threshold), _cut); \
+	if (_cut < (a).len && dcarr_elem((a), _cut).key_field < (threshold)) \
+		_cut++; \
+	(a).off = dcarr_idx((a), _cut); \
+	(a).len -= _cut; \
+	dcarr_reduce_size((a), elemtype); \
+}while(0)
+
+/*
+ * Keep only the elements x for which pred(x) is true, O(n). pred is the
+ * name of a function or a function-like macro. The kept elements are
+ * moved towards the beginning in one pass and the array is shrunk once.
+ */
+#define dcarr_retain_if(a, elemtype, pred) do{ \
+	unsigned int _r, _ri = (a).off, _wi = (a).off, _w = 0; \
+	for (_r = 0; _r < (a).len; _r++) { \
+		elemtype _x = (a).els[_ri]; \
+		if (pred(_x)) { \
+			(a).els[_wi] = _x; \
+			_wi = (_wi + 1) & ((a).cap - 1); \
+			_w++; \
+		} \
+		_ri = (_ri + 1) & ((a).cap - 1); \
+	} \
+	(a).len = _w; \
+	dcarr_reduce_size((a), elemtype); \
+}while(0)
+
+/*
+ * Remove elements equal (==) to the element before them, O(n). On a
+ * sorted array, this leaves only unique elements.
+ */
+#define dcarr_dedup_adjacent(a, elemtype) do{ \
+	if ((a).len > 1) { \
+		unsigned int _r, _ri = dcarr_idx((a), 1), _wi = (a).off, _w = 1; \
+		for (_r = 1; _r < (a).len; _r++) { \
+			if (!((a).els[_ri] == (a).els[_wi])) { \
+				_wi = (_wi + 1) & ((a).cap - 1); \
+				(a).els[_wi] = (a).els[_ri]; \
+				_w++; \
+			} \
+			_ri = (_ri + 1) & ((a).cap - 1); \
+		} \
+		(a).len = _w; \
+		dcarr_reduce_size((a), elemtype); \
+	} \
+}while(0)
+
+/*
+ * Searching
+ *
+ * These compare elements using ==, so they are for scalar element types.
+ * They loop over the array's two contiguous segments instead of indexing
+ * each element, and test a block of elements at a time without branching.
+ * The innermost loop goes over dcarr_lanes elements, a constant count, which
+ * GCC vectorizes already at -O2.
+ */
+
+/*
+ * Sets idx to the index of the first element equal to value, or to the
+ * length of the array if there is none.
+ */
+#define dcarr_find(a, elemtype, value, idx) do{ \
+	elemtype _val = (value); \
+	dcarr_search((a), elemtype, _x == _val, (idx)); \
+}while(0)
+
+/*
+ * Sets found to 1 if some element is equal to value, otherwise to 0.
+ */
+#define dcarr_contains(a, elemtype, value, found) do{ \
+	unsigned int _idx; \
+	dcarr_find((a), elemtype, (value), _idx); \
+	(found) = _idx < (a).len; \
+}while(0)
+
+/*
+ * Sets idx to the index of the first element x for which pred(x) is true,
+ * or to the length of the array. pred is the name of a function or a
+ * function-like macro.
+ */
+#define dcarr_find_if(a, elemtype, pred, idx) \
+	dcarr_search((a), elemtype, pred(_x), (idx))
+
+/*
+ * Sets count to the number of elements equal to value.
+ */
+#define dcarr_count(a, elemtype, value, count) do{ \
+	elemtype _val = (value); \
+	unsigned int _sg, _k, _l, _m, _c[dcarr_lanes]; \
+	const elemtype *_p; \
+	for (_l = 0; _l < dcarr_lanes; _l++) \
+		_c[_l] = 0; \
+	for (_sg = 0; _sg < 2 && (a).len > 0; _sg++) { \
+		dcarr_segment((a), _sg, _p, _m); \
+		for (_k = 0; _k + dcarr_lanes <= _m; _k += dcarr_lanes, _p += dcarr_lanes) \
+			for (_l = 0; _l < dcarr_lanes; _l++) \
+				_c[_l] += _p[_l] == _val; \
+		for (_l = 0; _l < _m - _k; _l++) \
+			_c[0] += _p[_l] == _val; \
+	} \
+	for (_l = 1; _l < dcarr_lanes; _l++) \
+		_c[0] += _c[_l]; \
+	(count) = _c[0]; \
+}while(0)
+
+/*
+ * Reductions
+ *
+ * Like the searching macros, these loop over the two contiguous segments.
+ * They keep dcarr_lanes independent accumulators, one per element in a
+ * block, so consecutive additions or comparisons don't wait for each other
+ * and the loops are vectorized at -O2 as for searching.
+ * min, max and minmax require a nonempty array.
+ */
+
+/*
+ * Sets result to the sum of the elements, added up in variables of type
+ * sumtype. For floating point, the result may differ from a sequential
+ * sum in the last bits.
+ */
+#define dcarr_sum(a, elemtype, sumtype, result) do{ \
+	sumtype _s[dcarr_lanes]; \
+	const elemtype *_p; \
+	unsigned int _sg, _k, _l, _m; \
+	for (_l = 0; _l < dcarr_lanes; _l++) \
+		_s[_l] = 0; \
+	for (_sg = 0; _sg < 2 && (a).len > 0; _sg++) { \
+		dcarr_segment((a), _sg, _p, _m); \
+		for (_k = 0; _k + dcarr_lanes <= _m; _k += dcarr_lanes, _p += dcarr_lanes) \
+			for (_l = 0; _l < dcarr_lanes; _l++) \
+				_s[_l] += _p[_l]; \
+		for (_l = 0; _l < _m - _k; _l++) \
+			_s[0] += _p[_l]; \
+	} \
+	/* add pairwise */ \
+	for (_m = dcarr_lanes / 2; _m > 0; _m /= 2) \
+		for (_l = 0; _l < _m; _l++) \
+			_s[_l] += _s[_l + _m]; \
+	(result) = _s[0]; \
+}while(0)
+
+/*
+ * Sets result to the sum of the elements with compensation for rounding
+ * errors (Kahan summation, in Neumaier's variant). For floating point
+ * types. This is sequential and much slower than dcarr_sum.
+ */
+#define dcarr_sum_compensated(a, elemtype, sumtype, result) do{ \
+	sumtype _s = 0, _c = 0, _t; \
+	const elemtype *_p; \
+	unsigned int _sg, _k, _m; \
+	for (_sg = 0; _sg < 2 && (a).len > 0; _sg++) { \
+		dcarr_segment((a), _sg, _p, _m); \
+		for (_k = 0; _k < _m; _k++) { \
+			_t = _s + _p[_k]; \
+			/* keep the low order bits lost in the addition */ \
+			if ((_s < 0 ? -_s : _s) >= (_p[_k] < 0 ? -_p[_k] : _p[_k])) \
+				_c += (_s - _t) + _p[_k]; \
+			else \
+				_c += (_p[_k] - _t) + _s; \
+			_s = _t; \
+		} \
+	} \
+	(result) = _s + _c; \
+}while(0)
+
+#define dcarr_min(a, elemtype, result) \
+	dcarr_extreme((a), elemtype, <, (result))
+
+#define dcarr_max(a, elemtype, result) \
+	dcarr_extreme((a), elemtype, >, (result))
+
+/*
+ * Sets min and max to the least and the greatest element in one pass.
+ */
+#define dcarr_minmax(a, elemtype, min, max) do{ \
+	elemtype _lo[dcarr_lanes], _hi[dcarr_lanes]; \
+	const elemtype *_p; \
+	unsigned int _sg, _k, _l, _m; \
+	for (_l = 0; _l < dcarr_lanes; _l++) \
+		_lo[_l] = _hi[_l] = dcarr_elem((a), 0); \
+	for (_sg = 0; _sg < 2; _sg++) { \
+		dcarr_segment((a), _sg, _p, _m); \
+		for (_k = 0; _k + dcarr_lanes <= _m; _k += dcarr_lanes, _p += dcarr_lanes) \
+			for (_l = 0; _l < dcarr_lanes; _l++) { \
+				_lo[_l] = _p[_l] < _lo[_l] ? _p[_l] : _lo[_l]; \
+				_hi[_l] = _p[_l] > _hi[_l] ? _p[_l] : _hi[_l]; \
+			} \
+		for (_l = 0; _l < _m - _k; _l++) { \
+			_lo[0] = _p[_l] < _lo[0] ? _p[_l] : _lo[0]; \
+			_hi[0] = _p[_l] > _hi[0] ? _p[_l] : _hi[0]; \
+		} \
+	} \
+	for (_l = 1; _l < dcarr_lanes; _l++) { \
+		_lo[0] = _lo[_l] < _lo[0] ? _lo[_l] : _lo[0]; \
+		_hi[0] = _hi[_l] > _hi[0] ? _hi[_l] : _hi[0]; \
+	} \
+	(min) = _lo[0]; \
+	(max) = _hi[0]; \
+}while(0)
+
+/*
+ * Stable sort according to less, the name of a function or a function-like
+ * macro as for the heap macros. Equal elements keep their order.
+ *
+ * This is a natural merge sort: blocks of 16 elements are insertion
+ * sorted, then adjacent ascending runs are merged pass by pass, so input
+ * which is already nearly sorted takes few passes. scratch is an empty
+ * array of the same type, whose buffer is grown to the length of a if
+ * needed and can be reused for later sorts.
+ */
+#define dcarr_stable_sort(a, elemtype, less, scratch) do{ \
+	unsigned int _n = (a).len, _i, _j, _lo, _mid, _hi, _runs; \
+	elemtype *_src, *_dst, *_tmp; \
+	if (_n > 1) { \
+		/* copy to scratch in order. a's buffer becomes the other half. */ \
+		dcarr_reserve((scratch), elemtype, _n); \
+		dcarr_copy_out((a), 0, _n, elemtype, (scratch).els); \
+		(a).off = 0; \
+		_src = (scratch).els; \
+		_dst = (a).els; \
+		for (_lo = 0; _lo < _n; _lo += 16) { \
+			_hi = _n - _lo > 16 ? _lo + 16 : _n; \
+			for (_i = _lo + 1; _i < _hi; _i++) { \
+				elemtype _v = _src[_i]; \
+				for (_j = _i; _j > _lo && less(_v, _src[_j - 1]); _j--) \
+					_src[_j] = _src[_j - 1]; \
+				_src[_j] = _v; \
+			} \
+		} \
+		do{ \
+			_runs = 0; \
+			for (_lo = 0; _lo < _n; _lo = _hi) { \
+				/* find the runs [lo, mid) and [mid, hi) and merge them */ \
+				for (_mid = _lo + 1; \
+				     _mid < _n && !less(_src[_mid], _src[_mid - 1]); _mid++); \
+				for (_hi = _mid < _n ? _mid + 1 : _n; \
+				     _hi < _n && !less(_src[_hi], _src[_hi - 1]); _hi++); \
+				dcarr_merge_runs(_src, _dst, _lo, _mid, _hi, less); \
+				_runs++; \
+			} \
+			_tmp = _src; \
+			_src = _dst; \
+			_dst = _tmp; \
+		}while(_runs > 1); \
+		if (_src != (a).els) \
+			memcpy((a).els, _src, sizeof(elemtype) * _n); \
+		dcarr_stat((a), moved, sizeof(elemtype) * _n); \
+	} \
+}while(0)
+
+/*
+ * Merge the k sorted arrays in the C array srcs into the end of dst,
+ * using a loser tree, O(n log k). Of equal elements, those from srcs with
+ * lower index come first. The srcs are not modified.
+ */
+#define dcarr_merge(dst, srcs, k, elemtype, less) do{ \
+	unsigned int _k = (k), _i, _total = 0, *_tree, *_pos; \
+	_tree = (unsigned int *)dcarr_alloc((2 * _k + 1) * sizeof(unsigned int)); \
+	if (!_tree) dcarr_oom(); \
+	_pos = _tree + _k + 1; \
+	for (_i = 0; _i < _k; _i++) { \
+		_tree[_i] = _k; /* k is a virtual leaf which beats all */ \
+		_pos[_i] = 0; \
+		_total += (srcs)[_i].len; \
+	} \
+	dcarr_reserve((dst), elemtype, _total); \
+	for (_i = _k; _i-- > 0; ) \
+		dcarr_merge_adjust((srcs), _k, _tree, _pos, _i, less); \
+	while (_k > 0 && _pos[_tree[0]] < (srcs)[_tree[0]].len) { \
+		_i = _tree[0]; \
+		dcarr_elem((dst), (dst).len) = dcarr_elem((srcs)[_i], _pos[_i]); \
+		(dst).len++; \
+		_pos[_i]++; \
+		dcarr_merge_adjust((srcs), _k, _tree, _pos, _i, less); \
+	} \
+	dcarr_free(_tree); \
+}while(0)
+
+/*
+ * Sets idx, an array of unsigned int, to the indices of the elements of a
+ * in sorted order, i.e. dcarr_elem(a, dcarr_elem(idx, 0)) is the least
+ * element. The sort is stable and a is not modified. Only the indices are
+ * moved, which is much less work than sorting large elements.
+ */
+#define dcarr_argsort(a, less, idx) do{ \
+	unsigned int _n = (a).len, _i, *_t; \
+	(idx).len = (idx).off = 0; \
+	dcarr_reserve((idx), unsigned int, _n); \
+	for (_i = 0; _i < _n; _i++) \
+		(idx).els[_i] = _i; \
+	(idx).len = _n; \
+	if (_n > 1) { \
+		_t = (unsigned int *)dcarr_alloc(_n * sizeof(unsigned int)); \
+		if (!_t) dcarr_oom(); \
+		dcarr_sort_by((idx).els, _t, _n, unsigned int, \
+		              less(dcarr_elem((a), _x), dcarr_elem((a), _y))); \
+		dcarr_free(_t); \
+	} \
+}while(0)
+
+/*
+ * Sorts an array of structs by the member key_field of type keytype. The
+ * (key, index) pairs are sorted, then each element is moved once to its
+ * place by following the cycles of the permutation. The sort is stable.
+ * This is faster than dcarr_sort when the elements are large compared to
+ * the keys.
+ */
+#define dcarr_sort_by_key(a, elemtype, keytype, key_field, less) do{ \
+	struct dcarr_key_pair { keytype key; unsigned int i; } *_kp, *_kt; \
+	unsigned int _n = (a).len, _i; \
+	if (_n > 1) { \
+		_kp = (struct dcarr_key_pair *) \
+			dcarr_alloc(2 * _n * sizeof(struct dcarr_key_pair)); \
+		if (!_kp) dcarr_oom(); \
+		_kt = _kp + _n; \
+		for (_i = 0; _i < _n; _i++) { \
+			_kp[_i].key = dcarr_elem((a), _i).key_field; \
+			_kp[_i].i = _i; \
+		} \
+		dcarr_sort_by(_kp, _kt, _n, struct dcarr_key_pair, \
+		              less(_x.key, _y.key)); \
+		dcarr_permute_cycles((a), elemtype, _n, _kp[_j].i); \
+		dcarr_free(_kp); \
+	} \
+}while(0)
+
+/*
+ * Selection
+ *
+ * These take a less function or macro like the heap macros. The array is
+ * first made contiguous as for dcarr_sort, not keeping the order.
+ */
+
+/*
+ * Reorder the elements so that the element at index nth is the one which
+ * would be there if the array was sorted, all elements before it are not
+ * greater and all elements after it are not less, O(n). This is
+ * introselect: quickselect with median of three pivots, falling back to
+ * heap sort if the partitioning goes bad.
+ */
+#define dcarr_nth_element(a, elemtype, nth, less) do{ \
+	unsigned int _lo = 0, _hi = (a).len, _nth = (nth), _depth = 0, _i, _j; \
+	elemtype *_p, _pv, _t; \
+	dcarr_compact((a), elemtype); \
+	_p = &((a).els[(a).off]); \
+	for (_i = (a).len; _i > 1; _i >>= 1) _depth += 2; \
+	while (_hi - _lo > 16) { \
+		if (_depth-- == 0) { \
+			dcarr_sort_range(_p, _lo, _hi, elemtype, less); \
+			break; \
+		} \
+		/* median of three, also guarding the partitioning */ \
+		_i = _lo + (_hi - _lo - 1) / 2; \
+		if (less(_p[_i], _p[_lo])) { _t = _p[_i]; _p[_i] = _p[_lo]; _p[_lo] = _t; } \
+		if (less(_p[_hi - 1], _p[_i])) { \
+			_t = _p[_i]; _p[_i] = _p[_hi - 1]; _p[_hi - 1] = _t; \
+			if (less(_p[_i], _p[_lo])) { _t = _p[_i]; _p[_i] = _p[_lo]; _p[_lo] = _t; } \
+		} \
+		_pv = _p[_i]; \
+		/* Hoare partitioning into [lo, j] and [j + 1, hi) */ \
+		_i = _lo - 1; \
+		_j = _hi; \
+		for (;;) { \
+			do _i++; while (less(_p[_i], _pv)); \
+			do _j--; while (less(_pv, _p[_j])); \
+			if (_i >= _j) break; \
+			_t = _p[_i]; _p[_i] = _p[_j]; _p[_j] = _t; \
+		} \
+		if (_nth <= _j) _hi = _j + 1; \
+		else _lo = _j + 1; \
+	} \
+	/* insertion sort what is left */ \
+	for (_i = _lo + 1; _i < _hi && _hi - _lo <= 16; _i++) { \
+		_t = _p[_i]; \
+		for (_j = _i; _j > _lo && less(_t, _p[_j - 1]); _j--) \
+			_p[_j] = _p[_j - 1]; \
+		_p[_j] = _t; \
+	} \
+}while(0)
+
+/*
+ * Reorder the elements so that the first k are the k least, in sorted
+ * order, O(n + k log k). The order of the rest is unspecified.
+ */
+#define dcarr_partial_sort(a, elemtype, k, less) do{ \
+	unsigned int _pk = (k); \
+	if (_pk < (a).len) \
+		dcarr_nth_element((a), elemtype, _pk, less); \
+	else \
+		dcarr_compact((a), elemtype); \
+	dcarr_sort_range(&((a).els[(a).off]), 0, \
+	                 _pk < (a).len ? _pk : (a).len, elemtype, less); \
+}while(0)
+
+/*
+ * Put the k greatest elements into the empty array out, greatest first,
+ * O(n log k). a is not modified. A min-heap of the k greatest elements
+ * seen so far is kept in out, so each element that doesn't belong there
+ * costs one comparison with the least of them.
+ */
+#define dcarr_top_k(a, elemtype, k, less, out) do{ \
+	unsigned int _tk = (k), _ti, _tm, _tn; \
+	elemtype _tx; \
+	dcarr_reserve((out), elemtype, _tk < (a).len ? _tk : (a).len); \
+	for (_ti = 0; _ti < (a).len && _tk > 0; _ti++) { \
+		_tx = dcarr_elem((a), _ti); \
+		if ((out).len < _tk) \
+			dcarr_heap_push((out), elemtype, _tx, less); \
+		else if (less(dcarr_elem((out), 0), _tx)) \
+			dcarr_heap_sift_down((out), 2, 0, _tx, less); \
+	} \
+	/* sort the heap by moving the least to the end, one by one */ \
+	_tn = (out).len; \
+	for (_tm = _tn; _tm > 1; _tm--) { \
+		_tx = dcarr_elem((out), _tm - 1); \
+		dcarr_elem((out), _tm - 1) = dcarr_elem((out), 0); \
+		(out).len = _tm - 1; \
+		dcarr_heap_sift_down((out), 2, 0, _tx, less); \
+	} \
+	(out).len = _tn; \
+}while(0)
+
+/*
+ * Binary search
+ *
+ * For arrays sorted according to less, the name of a function or a
+ * function-like macro, as for the heap macros. The search is branchless:
+ * each step halves the range using a conditional move instead of a jump,
+ * and the two elements which may be probed next are prefetched.
+ */
+
+/*
+ * Sets idx to the first index whose element is not less than key, or to
+ * the length if there is none.
+ */
+#define dcarr_lower_bound(a, elemtype, key, less, idx) do{ \
+	elemtype _key = (key); \
+	dcarr_bsearch((a), less(dcarr_elem((a), _b + _half), _key), (idx)); \
+	if ((idx) < (a).len && less(dcarr_elem((a), (idx)), _key)) (idx)++; \
+}while(0)
+
+/*
+ * Sets idx to the first index whose element is greater than key, or to
+ * the length if there is none.
+ */
+#define dcarr_upper_bound(a, elemtype, key, less, idx) do{ \
+	elemtype _key = (key); \
+	dcarr_bsearch((a), !less(_key, dcarr_elem((a), _b + _half)), (idx)); \
+	if ((idx) < (a).len && !less(_key, dcarr_elem((a), (idx)))) (idx)++; \
+}while(0)
+
+/*
+ * Insert value in a sorted array, after any equal elements, O(n)
+ */
+#define dcarr_insert_sorted(a, elemtype, value, less) do{ \
+	elemtype _value = (value); \
+	unsigned int _pos; \
+	dcarr_upper_bound((a), elemtype, _value, less, _pos); \
+	dcarr_insert((a), _pos, elemtype, _value); \
+}while(0)
+
+/*
+ * Set operations
+ *
+ * For arrays sorted in ascending order without duplicates, compared using
+ * < and ==, such as lists of integer IDs. The result replaces the content
+ * of dst, which must be another array. It is reserved once for the
+ * largest possible result.
+ *
+ * When the arrays have similar lengths, they are merged by a loop without
+ * branches on the values. When one is more than 32 times longer, each
+ * element of the shorter one is instead looked up in the longer one by
+ * galloping from the previous position, which is O(m log(n/m)).
+ */
+
+/*
+ * Sets dst to the elements which are in both a and b.
+ */
+#define dcarr_set_intersect(a, b, elemtype, dst) do{ \
+	unsigned int _i = 0, _j = 0, _k = 0, _na = (a).len, _nb = (b).len; \
+	elemtype _x, _y; \
+	(dst).len = (dst).off = 0; \
+	dcarr_reserve((dst), elemtype, _na < _nb ? _na : _nb); \
+	if (_na / 32 > _nb) \
+		dcarr_set_gallop_probe((b), (a), elemtype, (dst), _k, 1); \
+	else if (_nb / 32 > _na) \
+		dcarr_set_gallop_probe((a), (b), elemtype, (dst), _k, 1); \
+	else while (_i < _na && _j < _nb) { \
+		_x = dcarr_elem((a), _i); \
+		_y = dcarr_elem((b), _j); \
+		(dst).els[_k] = _x; \
+		_k += _x == _y; \
+		_i += !(_y < _x); \
+		_j += !(_x < _y); \
+	} \
+	(dst).len = _k; \
+}while(0)
+
+/*
+ * Sets dst to the elements which are in a, b or both.
+ */
+#define dcarr_set_union(a, b, elemtype, dst) do{ \
+	unsigned int _i = 0, _j = 0, _k = 0, _na = (a).len, _nb = (b).len; \
+	elemtype _x, _y; \
+	(dst).len = (dst).off = 0; \
+	dcarr_reserve((dst), elemtype, _na + _nb); \
+	if (_na / 32 > _nb) \
+		dcarr_set_gallop_runs((a), (b), elemtype, (dst), _k, 1); \
+	else if (_nb / 32 > _na) \
+		dcarr_set_gallop_runs((b), (a), elemtype, (dst), _k, 1); \
+	else { \
+		while (_i < _na && _j < _nb) { \
+			_x = dcarr_elem((a), _i); \
+			_y = dcarr_elem((b), _j); \
+			(dst).els[_k++] = _y < _x ? _y : _x; \
+			_i += !(_y < _x); \
+			_j += !(_x < _y); \
+		} \
+		dcarr_copy_out((a), _i, _na - _i, elemtype, (dst).els + _k); \
+		_k += _na - _i; \
+		dcarr_copy_out((b), _j, _nb - _j, elemtype, (dst).els + _k); \
+		_k += _nb - _j; \
+	} \
+	(dst).len = _k; \
+}while(0)
+
+/*
+ * Sets dst to the elements of a which are not in b.
+ */
+#define dcarr_set_difference(a, b, elemtype, dst) do{ \
+	unsigned int _i = 0, _j = 0, _k = 0, _na = (a).len, _nb = (b).len; \
+	elemtype _x, _y; \
+	(dst).len = (dst).off = 0; \
+	dcarr_reserve((dst), elemtype, _na); \
+	if (_na / 32 > _nb) \
+		dcarr_set_gallop_runs((a), (b), elemtype, (dst), _k, 0); \
+	else if (_nb / 32 > _na) \
+		dcarr_set_gallop_probe((a), (b), elemtype, (dst), _k, 0); \
+	else { \
+		while (_i < _na && _j < _nb) { \
+			_x = dcarr_elem((a), _i); \
+			_y = dcarr_elem((b), _j); \
+			(dst).els[_k] = _x; \
+			_k += _x < _y; \
+			_i += !(_y < _x); \
+			_j += !(_x < _y); \
+		} \
+		dcarr_copy_out((a), _i, _na - _i, elemtype, (dst).els + _k); \
+		_k += _na - _i; \
+	} \
+	(dst).len = _k; \
+}while(0)
+
+/*
+ * Gather and scatter
+ *
+ * idx points to n indices of elements in a. When n is large, the element
+ * dcarr_gather_ahead positions ahead is prefetched, so that the cache
+ * misses of random indices overlap.
+ */
+
+/*
+ * Copies the elements at the indices to the memory at out, i.e.
+ * out[i] = dcarr_elem(a, idx[i]).
+ */
+#define dcarr_gather(a, idx, n, out) do{ \
+	unsigned int _i = 0, _n = (n); \
+	if (_n > dcarr_gather_ahead) \
+		for (; _i < _n - dcarr_gather_ahead; _i++) { \
+			dcarr_prefetch(&dcarr_elem((a), (idx)[_i + dcarr_gather_ahead])); \
+			(out)[_i] = dcarr_elem((a), (idx)[_i]); \
+		} \
+	for (; _i < _n; _i++) \
+		(out)[_i] = dcarr_elem((a), (idx)[_i]); \
+}while(0)
+
+/*
+ * Copies the memory at in to the elements at the indices, i.e.
+ * dcarr_elem(a, idx[i]) = in[i]. If an index occurs more than once, the
+ * last one wins.
+ */
+#define dcarr_scatter(a, idx, n, in) do{ \
+	unsigned int _i = 0, _n = (n); \
+	if (_n > dcarr_gather_ahead) \
+		for (; _i < _n - dcarr_gather_ahead; _i++) { \
+			dcarr_prefetch(&dcarr_elem((a), (idx)[_i + dcarr_gather_ahead])); \
+			dcarr_elem((a), (idx)[_i]) = (in)[_i]; \
+		} \
+	for (; _i < _n; _i++) \
+		dcarr_elem((a), (idx)[_i]) = (in)[_i]; \
+}while(0)
+
+/*
+ * Reorders the elements in place as if they were gathered to a new array
+ * using idx, which points to a permutation of the indices 0 to len - 1,
+ * such as the els of an array filled by dcarr_argsort. Each element is
+ * moved once and only one element of temporary storage is used. The
+ * indices are modified while working but restored at the end, so they
+ * can't be constant.
+ */
+#define dcarr_permute(a, elemtype, idx) \
+	dcarr_permute_cycles((a), elemtype, (a).len, (idx)[_j])
+
 /*
  * Convert external index to internal one. (Used internally.)
  *
@@ -168,19 +992,23 @@
 #define dcarr_reserve(a, eltype, n) do{ \
 	if ((a).len + (n) > (a).cap) { \
 		unsigned int _cap = (a).cap; \
+		dcarr_stat((a), reserves, 1); \
 		/* calulate and set new capacity */ \
 		do{ \
 			(a).cap = (a).cap >= 8 ? (a).cap << 1 : 8; \
 		}while((a).len + (n) > (a).cap); \
+		dcarr_stat_peak(a); \
 		/* allocate more mem */ \
-		(a).els = (eltype *)dcarr_realloc((a).els, (a).cap * sizeof(eltype)); \
+		dcarr_realloc_els((a), eltype, _cap); \
+		dcarr_stat((a), reallocs, 1); \
 		if (!(a).els) dcarr_oom(); \
 		/* adjust content to the increased capacity */ \
 		if ((a).off + (a).len > _cap) { \
 			/* it warps around. make it warp around the new boundary. */ \
 			memmove(&((a).els[(a).off + (a).cap - _cap]), \
 			        &((a).els[(a).off]), \
-			        sizeof(eltype) * ((a).cap - _cap)); \
+			        sizeof(eltype) * (_cap - (a).off)); \
+			dcarr_stat((a), moved, sizeof(eltype) * (_cap - (a).off)); \
 			memset(&((a).els[(a).off]), 0, \
 			       sizeof(eltype) * ((a).cap - _cap)); \
 			(a).off += (a).cap - _cap; \
@@ -195,35 +1023,1640 @@
 	if ((a).len << 2 <= (a).cap && (a).cap > 8) {\
 		/* it is down to 1/4. reduce cap to len * 2 so it is half full */ \
 		unsigned int _cap = (a).cap; \
+		dcarr_stat((a), shrinks, 1); \
 		/* calulate and set new capacity */ \
 		do{ \
 			(a).cap = (a).cap >> 1; \
 		}while((a).len << 2 <= (a).cap && (a).cap > 8); \
 		/* adjust content to decreased capacity */ \
-		if ((a).off >= (a).cap) {\
+		if ((a).off + (a).len > _cap) { \
+			/* it warpped around already. move the part at the end of \
+			 * the old boundary to the end of the new boundary. */ \
+			memmove(&((a).els[(a).off + (a).cap - _cap]), \
+			        &((a).els[(a).off]), \
+			        sizeof(eltype) * (_cap - (a).off)); \
+			dcarr_stat((a), moved, sizeof(eltype) * (_cap - (a).off)); \
+			(a).off -= _cap - (a).cap; \
+		} \
+		else if ((a).off >= (a).cap) {\
 			/* the whole content is outside, but in one piece */ \
 			memcpy(&((a).els[0]), \
 			       &((a).els[(a).off]), \
 			       sizeof(eltype) * (a).len); \
+			dcarr_stat((a), moved, sizeof(eltype) * (a).len); \
 			(a).off = 0; \
 		} \
-		else if ((a).off + (a).len >= _cap) { \
-			/* it warpped around already. adjust to new boundary. */ \
-			memmove(&((a).els[(a).off + (a).cap - _cap]), \
-			        &((a).els[(a).off]), \
-			        sizeof(eltype) * ((a).cap - _cap)); \
-			(a).off += (a).cap - _cap; \
-		} \
 		else if ((a).off + (a).len > (a).cap) { \
 			/* it overflows the new cap. make it warp. */ \
 			memcpy(&((a).els[0]), \
 			       &((a).els[(a).cap]), \
 			       sizeof(eltype) * ((a).off + (a).len - (a).cap)); \
+			dcarr_stat((a), moved, \
+			           sizeof(eltype) * ((a).off + (a).len - (a).cap)); \
 		} \
 		/* free the unused part */ \
-		(a).els = (eltype *)dcarr_realloc((a).els, (a).cap * sizeof(eltype)); \
+		dcarr_realloc_els((a), eltype, _cap); \
+		dcarr_stat((a), reallocs, 1); \
+	} \
+}while(0)
+
+/*
+ * Sets p to memory for cap elements, aligned if the array has an
+ * alignment. The cast keeps it valid C++. (Used internally.)
+ */
+#define dcarr_alloc_els(a, eltype, p) do{ \
+	void *_vp; \
+	if ((a).align) \
+		dcarr_aligned_alloc(_vp, (a).align, \
+		                    ((a).cap * sizeof(eltype) + (a).align - 1) & \
+		                    ~(size_t)((a).align - 1)); \
+	else \
+		_vp = dcarr_alloc((a).cap * sizeof(eltype)); \
+	(p) = (eltype *)_vp; \
+}while(0)
+
+/*
+ * Reallocates the elements to the current cap, keeping the first
+ * oldcap of them. Aligned memory can't be realloc'ed, so then the
+ * elements are copied to a new allocation. (Used internally.)
+ */
+#define dcarr_realloc_els(a, eltype, oldcap) do{ \
+	if ((a).align) { \
+		eltype *_els; \
+		dcarr_alloc_els((a), eltype, _els); \
+		if (!_els) dcarr_oom(); \
+		if ((a).els) { \
+			memcpy(_els, (a).els, sizeof(eltype) * \
+			       ((oldcap) < (a).cap ? (oldcap) : (a).cap)); \
+			dcarr_stat((a), moved, sizeof(eltype) * \
+			           ((oldcap) < (a).cap ? (oldcap) : (a).cap)); \
+		} \
+		dcarr_free((a).els); \
+		(a).els = _els; \
+	} else { \
+		(a).els = (eltype *)dcarr_realloc((a).els, \
+		                                  (a).cap * sizeof(eltype)); \
+	} \
+}while(0)
+
+
+/*
+ * Let the empty array dst take over src's buffer, leaving src empty.
+ * (Used internally.)
+ */
+#define dcarr_take(dst, src) do{ \
+	dcarr_free((dst).els); \
+	(dst).els = (src).els; \
+	(dst).cap = (src).cap; \
+	(dst).off = (src).off; \
+	(dst).len = (src).len; \
+	(src).els = NULL; \
+	(src).cap = (src).off = (src).len = 0; \
+}while(0)
+
+/*
+ * Copy n elements from index i to the memory at p, using at most two
+ * memcpy. (Used internally.)
+ */
+#define dcarr_copy_out(a, i, n, eltype, p) do{ \
+	unsigned int _s = dcarr_idx((a), (i)), _cn = (n); \
+	unsigned int _c1 = (a).cap - _s < _cn ? (a).cap - _s : _cn; \
+	if (_cn > 0) { \
+		memcpy((p), &((a).els[_s]), sizeof(eltype) * _c1); \
+		memcpy((p) + _c1, &((a).els[0]), sizeof(eltype) * (_cn - _c1)); \
+		dcarr_stat((a), moved, sizeof(eltype) * _cn); \
+	} \
+}while(0)
+
+/*
+ * Copy n elements from the memory at p to index i, using at most two
+ * memcpy. The space must already be reserved. (Used internally.)
+ */
+#define dcarr_copy_in(a, i, n, eltype, p) do{ \
+	unsigned int _d = dcarr_idx((a), (i)), _cn = (n); \
+	unsigned int _c1 = (a).cap - _d < _cn ? (a).cap - _d : _cn; \
+	if (_cn > 0) { \
+		memcpy(&((a).els[_d]), (p), sizeof(eltype) * _c1); \
+		memcpy(&((a).els[0]), (p) + _c1, sizeof(eltype) * (_cn - _c1)); \
+		dcarr_stat((a), moved, sizeof(eltype) * _cn); \
 	} \
 }while(0)
 
 
+/*
+ * Copy n elements from index si in src to index di in dst, which must
+ * be reserved. Each of src's at most two segments is copied using
+ * dcarr_copy_in. (Used internally.)
+ */
+#define dcarr_copy_between(dst, di, src, si, n, eltype) do{ \
+	unsigned int _ss = dcarr_idx((src), (si)), _sn = (n); \
+	unsigned int _s1 = (src).cap - _ss < _sn ? (src).cap - _ss : _sn; \
+	dcarr_copy_in((dst), (di), _s1, eltype, &((src).els[_ss])); \
+	dcarr_copy_in((dst), (di) + _s1, _sn - _s1, eltype, (src).els); \
+}while(0)
+
+
+/*
+ * Sets idx to the index of the first element _x for which the expression
+ * cond is true, or to the length. Each block of 4 * dcarr_lanes elements
+ * is tested without an early exit, with a hit count per lane, then searched
+ * again element by element if there was a hit.
+ * (Used internally.)
+ */
+#define dcarr_search(a, elemtype, cond, idx) do{ \
+	unsigned int _sg, _k, _j, _l, _m, _n1, _base, _found = (a).len; \
+	int _hit[dcarr_lanes], _any; \
+	const elemtype *_p, *_q; \
+	_n1 = (a).cap - (a).off < (a).len ? (a).cap - (a).off : (a).len; \
+	for (_sg = 0; _sg < 2 && _found == (a).len && (a).len > 0; _sg++) { \
+		_p = _sg ? (a).els : &((a).els[(a).off]); \
+		_m = _sg ? (a).len - _n1 : _n1; \
+		_base = _sg ? _n1 : 0; \
+		for (_k = 0; _k + 4 * dcarr_lanes <= _m; _k += 4 * dcarr_lanes) { \
+			for (_l = 0; _l < dcarr_lanes; _l++) \
+				_hit[_l] = 0; \
+			for (_j = 0; _j < 4 * dcarr_lanes; _j += dcarr_lanes) { \
+				_q = _p + _k + _j; \
+				dcarr_nounroll \
+				for (_l = 0; _l < dcarr_lanes; _l++) { \
+					elemtype _x = _q[_l]; \
+					_hit[_l] += (cond) != 0; \
+				} \
+			} \
+			for (_any = 0, _l = 0; _l < dcarr_lanes; _l++) \
+				_any |= _hit[_l]; \
+			if (_any) break; \
+		} \
+		/* the block with the hit, or the rest */ \
+		for (; _k < _m; _k++) { \
+			elemtype _x = _p[_k]; \
+			if (cond) { \
+				_found = _base + _k; \
+				break; \
+			} \
+		} \
+	} \
+	(idx) = _found; \
+}while(0)
+
+
+/*
+ * Sets p and m to the start and the length of segment sg, 0 or 1, of the
+ * elements. The second segment is empty unless the content wraps around.
+ * (Used internally.)
+ */
+#define dcarr_segment(a, sg, p, m) do{ \
+	unsigned int _n1 = (a).cap - (a).off < (a).len \
+	                   ? (a).cap - (a).off : (a).len; \
+	(p) = (sg) ? (a).els : &((a).els[(a).off]); \
+	(m) = (sg) ? (a).len - _n1 : _n1; \
+}while(0)
+
+/*
+ * Sets result to the element x for which x op y holds for all other
+ * elements y. (Used internally.)
+ */
+#define dcarr_extreme(a, elemtype, op, result) do{ \
+	elemtype _e[dcarr_lanes]; \
+	const elemtype *_p; \
+	unsigned int _sg, _k, _l, _m; \
+	for (_l = 0; _l < dcarr_lanes; _l++) \
+		_e[_l] = dcarr_elem((a), 0); \
+	for (_sg = 0; _sg < 2; _sg++) { \
+		dcarr_segment((a), _sg, _p, _m); \
+		for (_k = 0; _k + dcarr_lanes <= _m; _k += dcarr_lanes, _p += dcarr_lanes) \
+			for (_l = 0; _l < dcarr_lanes; _l++) \
+				_e[_l] = _p[_l] op _e[_l] ? _p[_l] : _e[_l]; \
+		for (_l = 0; _l < _m - _k; _l++) \
+			_e[0] = _p[_l] op _e[0] ? _p[_l] : _e[0]; \
+	} \
+	for (_l = 1; _l < dcarr_lanes; _l++) \
+		_e[0] = _e[_l] op _e[0] ? _e[_l] : _e[0]; \
+	(result) = _e[0]; \
+}while(0)
+
+
+/*
+ * Narrows the range [0, len) down to one index, which is stored in idx.
+ * Each step moves to the upper half if the expression right, which tests
+ * the element at _b + _half, is true. The caller then tests the element
+ * at idx. (Used internally.)
+ */
+#define dcarr_bsearch(a, right, idx) do{ \
+	unsigned int _b = 0, _n = (a).len, _half; \
+	while (_n > 1) { \
+		_half = _n / 2; \
+		dcarr_prefetch(&dcarr_elem((a), _b + _half / 2)); \
+		dcarr_prefetch(&dcarr_elem((a), _b + _half + _half / 2)); \
+		_b = (right) ? _b + _half : _b; \
+		_n -= _half; \
+	} \
+	(idx) = _b; \
+}while(0)
+
+
+/*
+ * Advances j to the first index from j whose element is not less than x,
+ * or to the length. The step doubles while the elements are less, then
+ * the last step is halved down to one index. (Used internally.)
+ */
+#define dcarr_gallop(a, x, j) do{ \
+	unsigned int _glo = (j), _ghi = (j), _gstep = 1, _gmid; \
+	if (_ghi < (a).len && dcarr_elem((a), _ghi) < (x)) { \
+		do{ \
+			_glo = _ghi; \
+			_ghi = (a).len - _glo > _gstep ? _glo + _gstep : (a).len; \
+			_gstep *= 2; \
+		}while(_ghi < (a).len && dcarr_elem((a), _ghi) < (x)); \
+		/* the element at glo is less, the one at ghi is not */ \
+		while (_ghi - _glo > 1) { \
+			_gmid = _glo + (_ghi - _glo) / 2; \
+			if (dcarr_elem((a), _gmid) < (x)) _glo = _gmid; \
+			else _ghi = _gmid; \
+		} \
+	} \
+	(j) = _ghi; \
+}while(0)
+
+/*
+ * Looks up each element of the short array s in the long array l and
+ * appends it to dst at index k if it is found and keep is 1, or if it is
+ * not found and keep is 0. (Used internally.)
+ */
+#define dcarr_set_gallop_probe(s, l, elemtype, dst, k, keep) do{ \
+	unsigned int _si, _lj = 0; \
+	elemtype _sx; \
+	for (_si = 0; _si < (s).len; _si++) { \
+		_sx = dcarr_elem((s), _si); \
+		dcarr_gallop((l), _sx, _lj); \
+		if ((_lj < (l).len && dcarr_elem((l), _lj) == _sx) == (keep)) \
+			(dst).els[(k)++] = _sx; \
+	} \
+}while(0)
+
+/*
+ * Copies the long array l to dst at index k in runs between the elements
+ * of the short array s, skipping the elements equal to one in s. Each
+ * element of s is also appended if keep is 1. (Used internally.)
+ */
+#define dcarr_set_gallop_runs(l, s, elemtype, dst, k, keep) do{ \
+	unsigned int _si, _li = 0, _lj = 0; \
+	elemtype _sx; \
+	for (_si = 0; _si < (s).len; _si++) { \
+		_sx = dcarr_elem((s), _si); \
+		dcarr_gallop((l), _sx, _lj); \
+		dcarr_copy_out((l), _li, _lj - _li, elemtype, (dst).els + (k)); \
+		(k) += _lj - _li; \
+		if (keep) (dst).els[(k)++] = _sx; \
+		if (_lj < (l).len && dcarr_elem((l), _lj) == _sx) _lj++; \
+		_li = _lj; \
+	} \
+	dcarr_copy_out((l), _li, (l).len - _li, elemtype, (dst).els + (k)); \
+	(k) += (l).len - _li; \
+}while(0)
+
+/*
+ * Merge src[lo, mid) and src[mid, hi) into dst[lo, hi), taking from the
+ * first run when equal. (Used internally.)
+ */
+#define dcarr_merge_runs(src, dst, lo, mid, hi, less) do{ \
+	unsigned int _ra = (lo), _rb = (mid), _o = (lo); \
+	while (_ra < (mid) && _rb < (hi)) \
+		(dst)[_o++] = less((src)[_rb], (src)[_ra]) \
+		              ? (src)[_rb++] : (src)[_ra++]; \
+	while (_ra < (mid)) (dst)[_o++] = (src)[_ra++]; \
+	while (_rb < (hi)) (dst)[_o++] = (src)[_rb++]; \
+}while(0)
+
+/*
+ * True if leaf i of a loser tree beats leaf j. The virtual leaf k beats
+ * all, exhausted leaves lose and ties go to the lower index.
+ * (Used internally.)
+ */
+#define dcarr_merge_beats(srcs, k, pos, i, j, less) \
+	((i) == (k) || \
+	 ((j) != (k) && (pos)[i] < (srcs)[i].len && \
+	  ((pos)[j] >= (srcs)[j].len || \
+	   less(dcarr_elem((srcs)[i], (pos)[i]), \
+	        dcarr_elem((srcs)[j], (pos)[j])) || \
+	   (!less(dcarr_elem((srcs)[j], (pos)[j]), \
+	          dcarr_elem((srcs)[i], (pos)[i])) && (i) < (j)))))
+
+/*
+ * Replay the matches from a leaf to the root of a loser tree. Each node
+ * keeps the loser and the winner goes up to tree[0]. (Used internally.)
+ */
+#define dcarr_merge_adjust(srcs, k, tree, pos, leaf, less) do{ \
+	unsigned int _s = (leaf), _t = ((leaf) + (k)) / 2, _l; \
+	while (_t > 0) { \
+		if (dcarr_merge_beats((srcs), (k), (pos), (tree)[_t], _s, less)) { \
+			_l = _s; \
+			_s = (tree)[_t]; \
+			(tree)[_t] = _l; \
+		} \
+		_t /= 2; \
+	} \
+	(tree)[0] = _s; \
+}while(0)
+
+
+/*
+ * Stable merge sort of p[0, n) using tmp[0, n) as scratch space. The
+ * expression before is true if the element _x goes before _y.
+ * (Used internally.)
+ */
+#define dcarr_sort_by(p, tmp, n, type, before) do{ \
+	unsigned int _bn = (n), _bi, _bj, _blo, _bmid, _bhi, _bw, _bo; \
+	type *_bsrc = (p), *_bdst = (tmp), *_bt, _x, _y; \
+	for (_blo = 0; _blo < _bn; _blo += 16) { \
+		_bhi = _bn - _blo > 16 ? _blo + 16 : _bn; \
+		for (_bi = _blo + 1; _bi < _bhi; _bi++) { \
+			_x = _bsrc[_bi]; \
+			for (_bj = _bi; _bj > _blo; _bj--) { \
+				_y = _bsrc[_bj - 1]; \
+				if (!(before)) break; \
+				_bsrc[_bj] = _y; \
+			} \
+			_bsrc[_bj] = _x; \
+		} \
+	} \
+	for (_bw = 16; _bw < _bn; _bw *= 2) { \
+		for (_blo = 0; _blo < _bn; _blo += 2 * _bw) { \
+			_bmid = _bn - _blo > _bw ? _blo + _bw : _bn; \
+			_bhi = _bn - _bmid > _bw ? _bmid + _bw : _bn; \
+			_bi = _blo; \
+			_bj = _bmid; \
+			for (_bo = _blo; _bi < _bmid && _bj < _bhi; _bo++) { \
+				_x = _bsrc[_bj]; \
+				_y = _bsrc[_bi]; \
+				if (before) { _bdst[_bo] = _x; _bj++; } \
+				else { _bdst[_bo] = _y; _bi++; } \
+			} \
+			while (_bi < _bmid) _bdst[_bo++] = _bsrc[_bi++]; \
+			while (_bj < _bhi) _bdst[_bo++] = _bsrc[_bj++]; \
+		} \
+		_bt = _bsrc; \
+		_bsrc = _bdst; \
+		_bdst = _bt; \
+	} \
+	if (_bsrc != (p)) \
+		memcpy((p), _bsrc, sizeof(type) * _bn); \
+}while(0)
+
+/*
+ * Moves element src to index _j for each _j < n, where src is an lvalue
+ * expression of _j, by following the cycles of the permutation. Each
+ * element is moved once. The visited indices are marked using the high
+ * bit of src, which is cleared again at the end. (Used internally.)
+ */
+#define dcarr_permute_cycles(a, elemtype, n, src) do{ \
+	unsigned int _c, _j, _s, _mark = ~0u / 2 + 1; \
+	elemtype _t; \
+	for (_c = 0; _c < (n); _c++) { \
+		_j = _c; \
+		if (((src) & _mark) || (src) == _c) continue; \
+		_t = dcarr_elem((a), _c); \
+		for (;;) { \
+			_s = (src); \
+			(src) |= _mark; \
+			if (_s == _c) break; \
+			dcarr_elem((a), _j) = dcarr_elem((a), _s); \
+			_j = _s; \
+		} \
+		dcarr_elem((a), _j) = _t; \
+	} \
+	for (_j = 0; _j < (n); _j++) \
+		(src) &= ~_mark; \
+}while(0)
+
+/*
+ * Make the elements contiguous, not keeping their order. If they wrap
+ * around, the first part is moved to just after the second part.
+ * (Used internally.)
+ */
+#define dcarr_compact(a, elemtype) do{ \
+	if ((a).off + (a).len > (a).cap) { \
+		/* it warps around. just move the parts together. */ \
+		memmove(&((a).els[(a).off + (a).len - (a).cap]), \
+		        &((a).els[(a).off]), \
+		        sizeof(elemtype) * ((a).cap - (a).off)); \
+		dcarr_stat((a), moved, sizeof(elemtype) * ((a).cap - (a).off)); \
+		(a).off = 0; \
+	} \
+}while(0)
+
+/*
+ * Heap sort of p[lo, hi), O(n log n) without extra memory.
+ * (Used internally.)
+ */
+#define dcarr_sort_range(p, lo, hi, elemtype, less) do{ \
+	unsigned int _sn = (hi) - (lo), _si = _sn / 2, _sh, _sc; \
+	elemtype *_sp = (p) + (lo), _sv; \
+	while (_sn > 1) { \
+		if (_si > 0) { \
+			/* build the max-heap bottom up */ \
+			_sh = --_si; \
+			_sv = _sp[_sh]; \
+		} else { \
+			/* move the greatest to the end */ \
+			_sv = _sp[--_sn]; \
+			_sp[_sn] = _sp[0]; \
+			_sh = 0; \
+		} \
+		while ((_sc = 2 * _sh + 1) < _sn) { \
+			if (_sc + 1 < _sn && less(_sp[_sc], _sp[_sc + 1])) _sc++; \
+			if (!less(_sv, _sp[_sc])) break; \
+			_sp[_sh] = _sp[_sc]; \
+			_sh = _sc; \
+		} \
+		_sp[_sh] = _sv; \
+	} \
+}while(0)
+
+
+/*
+ * Bounded arrays
+ *
+ * An ordinary array can be given a fixed capacity using dcarr_bounded_init
+ * and then be used with the dcarr_bounded_ macros, which never allocate,
+ * reallocate or free. When the array is full, dcarr_bounded_push
+ * overwrites the oldest element, the first one, while
+ * dcarr_bounded_try_push rejects the new element. Elements can be read
+ * using dcarr_elem and dcarr_len as usual.
+ */
+
+/*
+ * Allocates the array with room for capacity elements, rounded up to a
+ * power of 2.
+ */
+#define dcarr_bounded_init(a, elemtype, capacity) do{ \
+	dcarr_init(a); \
+	(a).cap = 1; \
+	while ((a).cap < (capacity)) (a).cap <<= 1; \
+	(a).els = (elemtype *)dcarr_alloc((a).cap * sizeof(elemtype)); \
+	if (!(a).els) dcarr_oom(); \
+	dcarr_stat_peak(a); \
+}while(0)
+
+/*
+ * Insert an element at the end, overwriting the first element if full.
+ */
+#define dcarr_bounded_push(a, elemtype, value) do{ \
+	if ((a).len == (a).cap) { \
+		(a).els[(a).off] = (value); \
+		(a).off = dcarr_idx((a), 1); \
+	} else { \
+		(a).els[dcarr_idx((a), (a).len++)] = (value); \
+	} \
+}while(0)
+
+/*
+ * Insert an element at the end if there is room. Sets ok to 0 if full.
+ */
+#define dcarr_bounded_try_push(a, elemtype, value, ok) do{ \
+	(ok) = (a).len < (a).cap; \
+	if ((a).len < (a).cap) \
+		(a).els[dcarr_idx((a), (a).len++)] = (value); \
+}while(0)
+
+/*
+ * Remove an element at the beginning and return its value
+ */
+#define dcarr_bounded_shift(a, elemtype, value) do{ \
+	(value) = (a).els[(a).off]; \
+	(a).off = dcarr_idx((a), 1); \
+	(a).len--; \
+}while(0)
+
+/*
+ * Remove an element at the end and return its value
+ */
+#define dcarr_bounded_pop(a, elemtype, value) do{ \
+	(value) = (a).els[dcarr_idx((a), --(a).len)]; \
+}while(0)
+
+
+/*
+ * Fixed capacity arrays
+ *
+ * An array type defined with dcarr_define_fixed_type stores capacity
+ * elements inline in the struct, so there is no allocation and no pointer
+ * to follow. The capacity is a compile time constant, so the index mask
+ * is an immediate in the code. The capacity must be a power of 2, or the
+ * type fails to compile.
+ *
+ * Inserting into a full array is undefined. Use dcarr_fixed_full to check.
+ */
+#define dcarr_define_fixed_type(arraytype, elemtype, capacity) \
+	typedef struct arraytype { \
+		unsigned int off; \
+		unsigned int len; \
+		elemtype els[capacity]; \
+		dcarr_assert_pow2_member(capacity) \
+	} arraytype
+
+#define dcarr_fixed_init(a) do{ \
+	(a).off = (a).len = 0; \
+}while(0)
+
+/*
+ * The capacity, a constant expression.
+ */
+#define dcarr_fixed_cap(a) (sizeof((a).els) / sizeof((a).els[0]))
+
+#define dcarr_fixed_full(a) ((a).len == dcarr_fixed_cap(a))
+
+/*
+ * Convert external index to internal one. (Used internally.)
+ */
+#define dcarr_fixed_idx(a, i) \
+	(((a).off + (i)) & (dcarr_fixed_cap(a) - 1))
+
+/*
+ * Access the element at index i, possible to assign to.
+ */
+#define dcarr_fixed_elem(a, i) \
+	((a).els[dcarr_fixed_idx((a), (i))])
+
+#define dcarr_fixed_unshift(a, elemtype, value) do{ \
+	(a).off = dcarr_fixed_idx((a), dcarr_fixed_cap(a) - 1); \
+	(a).els[(a).off] = (value); \
+	(a).len++; \
+}while(0)
+
+#define dcarr_fixed_shift(a, elemtype, value) do{ \
+	(value) = (a).els[(a).off]; \
+	(a).off = dcarr_fixed_idx((a), 1); \
+	(a).len--; \
+}while(0)
+
+#define dcarr_fixed_push(a, elemtype, value) do{ \
+	(a).els[dcarr_fixed_idx((a), (a).len++)] = (value); \
+}while(0)
+
+#define dcarr_fixed_pop(a, elemtype, value) do{ \
+	(value) = (a).els[dcarr_fixed_idx((a), --(a).len)]; \
+}while(0)
+
+
+/*
+ * Heaps
+ *
+ * An ordinary array can be used as a priority queue, where element 0 is
+ * the least element. The less parameter is the name of a function or
+ * function-like macro taking two elements, e.g.
+ *
+ *     #define int_less(x, y) ((x) < (y))
+ *
+ * which is expanded inline. The _d variants take the number of children
+ * per node. A 4-ary heap is less deep and keeps the children of a node in
+ * the same cache line, which is often faster than the binary heap.
+ */
+#define dcarr_heap_push(a, elemtype, value, less) \
+	dcarr_heap_push_d((a), elemtype, 2, (value), less)
+#define dcarr_heap_pop(a, elemtype, value, less) \
+	dcarr_heap_pop_d((a), elemtype, 2, (value), less)
+#define dcarr_heapify(a, elemtype, less) \
+	dcarr_heapify_d((a), elemtype, 2, less)
+
+#define dcarr_heap4_push(a, elemtype, value, less) \
+	dcarr_heap_push_d((a), elemtype, 4, (value), less)
+#define dcarr_heap4_pop(a, elemtype, value, less) \
+	dcarr_heap_pop_d((a), elemtype, 4, (value), less)
+#define dcarr_heapify4(a, elemtype, less) \
+	dcarr_heapify_d((a), elemtype, 4, less)
+
+/*
+ * Insert an element in a d-ary heap, O(log n)
+ */
+#define dcarr_heap_push_d(a, elemtype, d, value, less) do{ \
+	elemtype _v = (value); \
+	unsigned int _hole; \
+	dcarr_reserve((a), elemtype, 1); \
+	_hole = (a).len++; \
+	while (_hole > 0 && less(_v, dcarr_elem((a), (_hole - 1) / (d)))) { \
+		dcarr_elem((a), _hole) = dcarr_elem((a), (_hole - 1) / (d)); \
+		_hole = (_hole - 1) / (d); \
+	} \
+	dcarr_elem((a), _hole) = _v; \
+}while(0)
+
+/*
+ * Remove the least element of a d-ary heap and return its value, O(log n)
+ */
+#define dcarr_heap_pop_d(a, elemtype, d, value, less) do{ \
+	elemtype _last; \
+	(value) = dcarr_elem((a), 0); \
+	dcarr_pop((a), elemtype, _last); \
+	if ((a).len > 0) \
+		dcarr_heap_sift_down((a), d, 0, _last, less); \
+}while(0)
+
+/*
+ * Turns an array into a d-ary heap, O(n)
+ */
+#define dcarr_heapify_d(a, elemtype, d, less) do{ \
+	unsigned int _i = (a).len > 1 ? ((a).len - 2) / (d) + 1 : 0; \
+	while (_i-- > 0) { \
+		elemtype _v = dcarr_elem((a), _i); \
+		dcarr_heap_sift_down((a), d, _i, _v, less); \
+	} \
+}while(0)
+
+/*
+ * Moves the hole at index i down until v can be stored in it.
+ * (Used internally.)
+ */
+#define dcarr_heap_sift_down(a, d, i, v, less) do{ \
+	unsigned int _h = (i), _c, _b, _k; \
+	while ((_c = _h * (d) + 1) < (a).len) { \
+		/* find the least child */ \
+		_b = _c; \
+		for (_k = _c + 1; _k < _c + (d) && _k < (a).len; _k++) \
+			if (less(dcarr_elem((a), _k), dcarr_elem((a), _b))) _b = _k; \
+		if (!less(dcarr_elem((a), _b), (v))) break; \
+		dcarr_elem((a), _h) = dcarr_elem((a), _b); \
+		_h = _b; \
+	} \
+	dcarr_elem((a), _h) = (v); \
+}while(0)
+
+
+/*
+ * Sliding window minimum and maximum
+ *
+ * A window type defined with dcarr_window_define_type keeps the minimum
+ * or maximum of the last size values added, in amortized O(1) per value.
+ * It is a dcarr of (index, value) pairs where the values are monotonic:
+ * adding a value first pops the values at the end which can never become
+ * the extreme again, then the value at the beginning is shifted out when
+ * its index falls outside the window. The extreme is always at the
+ * beginning. The values are compared using < and >.
+ *
+ * A window must only be used with one of dcarr_window_min and
+ * dcarr_window_max. These take the window type, since the pairs and the
+ * dcarr of them, windowtype_pair and windowtype_queue, are defined along
+ * with it.
+ */
+#define dcarr_window_define_type(windowtype, valuetype) \
+	typedef struct windowtype##_pair { \
+		unsigned long idx; \
+		valuetype val; \
+	} windowtype##_pair; \
+	dcarr_define_type(windowtype##_queue, windowtype##_pair); \
+	typedef struct windowtype { \
+		windowtype##_queue q; \
+		unsigned long next; \
+		unsigned long size; \
+	} windowtype
+
+/*
+ * Initializes a window covering the last size values. A window always
+ * holds the value just added, so a size of 0 is taken as 1.
+ */
+#define dcarr_window_init(w, windowsize) do{ \
+	dcarr_init((w).q); \
+	(w).next = 0; \
+	(w).size = (windowsize) > 0 ? (windowsize) : 1; \
+}while(0)
+
+#define dcarr_window_destroy(w) do{ \
+	dcarr_destroy((w).q); \
+}while(0)
+
+/*
+ * Returns the minimum or maximum of the values in the window. The window
+ * must not be empty.
+ */
+#define dcarr_window_value(w) (dcarr_elem((w).q, 0).val)
+
+/*
+ * Adds value to the window and sets result to the minimum of the window.
+ */
+#define dcarr_window_min(w, windowtype, value, result) \
+	dcarr_window_add((w), windowtype, (value), <, (result))
+
+/*
+ * Adds value to the window and sets result to the maximum of the window.
+ */
+#define dcarr_window_max(w, windowtype, value, result) \
+	dcarr_window_add((w), windowtype, (value), >, (result))
+
+/*
+ * Adds a value, keeping the pairs ordered by op. (Used internally.)
+ */
+#define dcarr_window_add(w, windowtype, value, op, result) do{ \
+	windowtype##_pair _pair; \
+	_pair.idx = (w).next++; \
+	_pair.val = (value); \
+	/* drop from the end, then push */ \
+	while ((w).q.len > 0 && \
+	       !(dcarr_elem((w).q, (w).q.len - 1).val op _pair.val)) \
+		(w).q.len--; \
+	dcarr_push((w).q, windowtype##_pair, _pair); \
+	/* drop from the beginning what has left the window */ \
+	while (dcarr_elem((w).q, 0).idx + (w).size <= _pair.idx) { \
+		(w).q.off = dcarr_idx((w).q, 1); \
+		(w).q.len--; \
+	} \
+	dcarr_reduce_size((w).q, windowtype##_pair); \
+	(result) = dcarr_window_value(w); \
+}while(0)
+
+
+/*
+ * Incremental resizing
+ *
+ * An array type defined with dcarr_inc_define_type never copies its whole
+ * content at once. When it grows, a new buffer is allocated and the old
+ * one is kept. Each subsequent push, pop, shift or unshift then migrates
+ * dcarr_inc_batch elements to the new buffer, until the old one can be
+ * freed. This bounds the worst case time of each operation, at the cost
+ * of keeping two buffers for a while.
+ *
+ * The logical range [mlo, mhi) is still in the old buffer. Incremental
+ * arrays are never shrunk automatically. For aligned buffers, use
+ * dcarr_init_aligned after dcarr_inc_init. After dcarr_inc_finish, the
+ * other dcarr macros may be used on the array as well.
+ */
+#define dcarr_inc_define_type(arraytype, elemtype) \
+	typedef struct arraytype { \
+		elemtype *els; \
+		unsigned int cap; \
+		unsigned int off; \
+		unsigned int len; \
+		unsigned int align; \
+		elemtype *old; \
+		unsigned int oldcap; \
+		unsigned int oldoff; \
+		unsigned int mlo; \
+		unsigned int mhi; \
+		dcarr_stats_member \
+	} arraytype
+
+#define dcarr_inc_init(a) do{ \
+	dcarr_init(a); \
+	(a).old = NULL; \
+	(a).oldcap = (a).oldoff = (a).mlo = (a).mhi = 0; \
+}while(0)
+
+#define dcarr_inc_destroy(a) do{ \
+	dcarr_free((a).els); \
+	dcarr_free((a).old); \
+}while(0)
+
+/*
+ * Access the element at index i, possible to assign to.
+ */
+#define dcarr_inc_elem(a, i) \
+	(*((i) >= (a).mlo && (i) < (a).mhi \
+	   ? &((a).old[((a).oldoff + (i)) & ((a).oldcap - 1)]) \
+	   : &((a).els[dcarr_idx((a), (i))])))
+
+#define dcarr_inc_push(a, eltype, value) do{ \
+	dcarr_inc_reserve((a), eltype, 1); \
+	(a).els[dcarr_idx((a), (a).len++)] = (value); \
+	dcarr_inc_step((a), eltype, dcarr_inc_batch); \
+}while(0)
+
+#define dcarr_inc_unshift(a, eltype, value) do{ \
+	dcarr_inc_reserve((a), eltype, 1); \
+	(a).off = dcarr_idx((a), (a).cap - 1); \
+	if ((a).old) { \
+		(a).oldoff = ((a).oldoff + (a).oldcap - 1) & ((a).oldcap - 1); \
+		(a).mlo++; \
+		(a).mhi++; \
+	} \
+	(a).els[(a).off] = (value); \
+	(a).len++; \
+	dcarr_inc_step((a), eltype, dcarr_inc_batch); \
+}while(0)
+
+#define dcarr_inc_pop(a, eltype, value) do{ \
+	(value) = dcarr_inc_elem((a), (a).len - 1); \
+	(a).len--; \
+	if ((a).mhi > (a).len) (a).mhi = (a).len; \
+	dcarr_inc_step((a), eltype, dcarr_inc_batch); \
+}while(0)
+
+#define dcarr_inc_shift(a, eltype, value) do{ \
+	(value) = dcarr_inc_elem((a), 0); \
+	(a).off = dcarr_idx((a), 1); \
+	(a).len--; \
+	if ((a).old) { \
+		(a).oldoff = ((a).oldoff + 1) & ((a).oldcap - 1); \
+		if ((a).mlo) (a).mlo--; \
+		if ((a).mhi) (a).mhi--; \
+	} \
+	dcarr_inc_step((a), eltype, dcarr_inc_batch); \
+}while(0)
+
+/*
+ * Migrate up to n elements from the old buffer. Frees the old buffer
+ * when it is empty. (Used internally.)
+ */
+#define dcarr_inc_step(a, eltype, n) do{ \
+	unsigned int _k = (n); \
+	while (_k > 0 && (a).mlo < (a).mhi) { \
+		(a).els[dcarr_idx((a), (a).mlo)] = \
+			(a).old[((a).oldoff + (a).mlo) & ((a).oldcap - 1)]; \
+		dcarr_stat((a), moved, sizeof(eltype)); \
+		(a).mlo++; \
+		_k--; \
+	} \
+	if ((a).old && (a).mlo >= (a).mhi) { \
+		dcarr_free((a).old); \
+		(a).old = NULL; \
+		(a).mlo = (a).mhi = 0; \
+	} \
+}while(0)
+
+/*
+ * Completes an ongoing migration, O(n).
+ */
+#define dcarr_inc_finish(a, eltype) \
+	dcarr_inc_step((a), eltype, (a).mhi - (a).mlo)
+
+/*
+ * Reserve space for at least n more elements, without copying. The content
+ * stays in the old buffer and is migrated by later operations.
+ */
+#define dcarr_inc_reserve(a, eltype, n) do{ \
+	if ((a).len + (n) > (a).cap) { \
+		dcarr_inc_finish((a), eltype); \
+		dcarr_stat((a), reserves, 1); \
+		(a).old = (a).els; \
+		(a).oldcap = (a).cap; \
+		(a).oldoff = (a).off; \
+		(a).mlo = 0; \
+		(a).mhi = (a).len; \
+		do{ \
+			(a).cap = (a).cap >= 8 ? (a).cap << 1 : 8; \
+		}while((a).len + (n) > (a).cap); \
+		dcarr_stat_peak(a); \
+		dcarr_alloc_els((a), eltype, (a).els); \
+		dcarr_stat((a), reallocs, 1); \
+		if (!(a).els) dcarr_oom(); \
+		/* free the old buffer at once if it is empty */ \
+		dcarr_inc_step((a), eltype, 0); \
+	} \
+}while(0)
+
+
+/*
+ * Segmented arrays
+ *
+ * An array type defined with dcarr_seg_define_type stores its elements in
+ * chunks of dcarr_seg_chunk elements. The chunk pointers are kept in an
+ * ordinary dcarr, the map. Growing at either end only allocates a chunk
+ * and possibly grows the small map, so the elements are never moved and
+ * pointers to them stay valid until they are removed.
+ *
+ * The elements occupy positions [off, off + len) counted from the start
+ * of the first chunk, where off is less than dcarr_seg_chunk. The map is
+ * of the type arraytype_map, defined along with the array type.
+ */
+#define dcarr_seg_define_type(arraytype, elemtype) \
+	dcarr_define_type(arraytype##_map, elemtype *); \
+	typedef struct arraytype { \
+		arraytype##_map map; \
+		unsigned int off; \
+		unsigned int len; \
+	} arraytype
+
+#define dcarr_seg_init(a) do{ \
+	dcarr_init((a).map); \
+	(a).off = (a).len = 0; \
+}while(0)
+
+#define dcarr_seg_destroy(a) do{ \
+	unsigned int _i; \
+	for (_i = 0; _i < dcarr_len((a).map); _i++) \
+		dcarr_free(dcarr_elem((a).map, _i)); \
+	dcarr_destroy((a).map); \
+}while(0)
+
+/*
+ * Access the element at index i, possible to assign to.
+ */
+#define dcarr_seg_elem(a, i) \
+	(dcarr_elem((a).map, ((a).off + (i)) / dcarr_seg_chunk) \
+	           [((a).off + (i)) % dcarr_seg_chunk])
+
+#define dcarr_seg_push(a, elemtype, value) do{ \
+	if ((a).off + (a).len == dcarr_len((a).map) * dcarr_seg_chunk) { \
+		elemtype *_chunk = (elemtype *)dcarr_alloc(dcarr_seg_chunk * \
+		                                           sizeof(elemtype)); \
+		if (!_chunk) dcarr_oom(); \
+		dcarr_push((a).map, elemtype *, _chunk); \
+	} \
+	dcarr_seg_elem((a), (a).len) = (value); \
+	(a).len++; \
+}while(0)
+
+#define dcarr_seg_unshift(a, elemtype, value) do{ \
+	if ((a).off == 0) { \
+		elemtype *_chunk = (elemtype *)dcarr_alloc(dcarr_seg_chunk * \
+		                                           sizeof(elemtype)); \
+		if (!_chunk) dcarr_oom(); \
+		dcarr_unshift((a).map, elemtype *, _chunk); \
+		(a).off = dcarr_seg_chunk; \
+	} \
+	(a).off--; \
+	(a).len++; \
+	dcarr_seg_elem((a), 0) = (value); \
+}while(0)
+
+/*
+ * Remove an element at the end, freeing the last chunk if it becomes
+ * unused.
+ */
+#define dcarr_seg_pop(a, elemtype, value) do{ \
+	(a).len--; \
+	(value) = dcarr_seg_elem((a), (a).len); \
+	if (((a).off + (a).len) % dcarr_seg_chunk == 0) { \
+		elemtype *_chunk; \
+		dcarr_pop((a).map, elemtype *, _chunk); \
+		dcarr_free(_chunk); \
+	} \
+}while(0)
+
+/*
+ * Remove an element at the beginning, freeing the first chunk if it
+ * becomes unused.
+ */
+#define dcarr_seg_shift(a, elemtype, value) do{ \
+	(value) = dcarr_seg_elem((a), 0); \
+	(a).off++; \
+	(a).len--; \
+	if ((a).off == dcarr_seg_chunk) { \
+		elemtype *_chunk; \
+		dcarr_shift((a).map, elemtype *, _chunk); \
+		dcarr_free(_chunk); \
+		(a).off = 0; \
+	} \
+}while(0)
+
+
+/*
+ * Tiered arrays
+ *
+ * An array type defined with dcarr_tier_define_type is a dcarr of tiers,
+ * where each tier is a circular buffer of tiersize elements, a power of 2
+ * or the type fails to compile.
+ * All tiers are full except the last one, so random access is O(1).
+ * Inserting or removing in the middle only moves elements within one
+ * tier, then moves one element between the ends of each following tier.
+ * This is O(tiersize + n / tiersize), or O(sqrt(n)) with a tier size
+ * around the square root of the expected length.
+ *
+ * Since the tiers are allocated here, these macros take the array type
+ * rather than the element type. The tiers and the map of tier pointers
+ * are of the types arraytype_tier and arraytype_map.
+ */
+#define dcarr_tier_define_type(arraytype, elemtype, tiersize) \
+	typedef struct arraytype##_tier { \
+		unsigned int off; \
+		elemtype els[tiersize]; \
+		dcarr_assert_pow2_member(tiersize) \
+	} arraytype##_tier; \
+	dcarr_define_type(arraytype##_map, arraytype##_tier *); \
+	typedef struct arraytype { \
+		arraytype##_map map; \
+		unsigned int len; \
+	} arraytype
+
+#define dcarr_tier_init(a) do{ \
+	dcarr_init((a).map); \
+	(a).len = 0; \
+}while(0)
+
+#define dcarr_tier_destroy(a) do{ \
+	unsigned int _j; \
+	for (_j = 0; _j < dcarr_len((a).map); _j++) \
+		dcarr_free(dcarr_elem((a).map, _j)); \
+	dcarr_destroy((a).map); \
+}while(0)
+
+/*
+ * The number of elements per tier. (Used internally.)
+ */
+#define dcarr_tier_size(a) \
+	(sizeof((a).map.els[0]->els) / sizeof((a).map.els[0]->els[0]))
+
+/*
+ * Element at index q within tier j. (Used internally.)
+ */
+#define dcarr_tier_el(a, j, q) \
+	(dcarr_elem((a).map, (j))->els[(dcarr_elem((a).map, (j))->off + (q)) \
+	                                & (dcarr_tier_size(a) - 1)])
+
+/*
+ * Access the element at index i, possible to assign to.
+ */
+#define dcarr_tier_elem(a, i) \
+	dcarr_tier_el((a), (i) / dcarr_tier_size(a), (i) % dcarr_tier_size(a))
+
+/*
+ * Insert at an arbitrary position, O(tiersize + n / tiersize)
+ */
+#define dcarr_tier_insert(a, i, arraytype, value) do{ \
+	unsigned int _k = (i) / dcarr_tier_size(a); \
+	unsigned int _p = (i) % dcarr_tier_size(a); \
+	unsigned int _j, _q, _cnt; \
+	if ((a).len == dcarr_len((a).map) * dcarr_tier_size(a)) { \
+		/* all tiers are full. add one. */ \
+		arraytype##_tier *_tier = \
+			(arraytype##_tier *)dcarr_alloc(sizeof(arraytype##_tier)); \
+		if (!_tier) dcarr_oom(); \
+		_tier->off = 0; \
+		dcarr_push((a).map, arraytype##_tier *, _tier); \
+	} \
+	/* move the last element of each full tier to the next tier */ \
+	for (_j = dcarr_len((a).map) - 1; _j > _k; _j--) { \
+		dcarr_elem((a).map, _j)->off = \
+			(dcarr_elem((a).map, _j)->off - 1) & (dcarr_tier_size(a) - 1); \
+		dcarr_tier_el((a), _j, 0) = \
+			dcarr_tier_el((a), _j - 1, dcarr_tier_size(a) - 1); \
+	} \
+	/* insert within tier k, which now has room for one more */ \
+	_cnt = _k == dcarr_len((a).map) - 1 \
+	       ? (a).len - _k * dcarr_tier_size(a) \
+	       : dcarr_tier_size(a) - 1; \
+	if (_p < _cnt / 2) { \
+		/* move the beginning of the tier backwards */ \
+		dcarr_elem((a).map, _k)->off = \
+			(dcarr_elem((a).map, _k)->off - 1) & (dcarr_tier_size(a) - 1); \
+		for (_q = 0; _q < _p; _q++) \
+			dcarr_tier_el((a), _k, _q) = dcarr_tier_el((a), _k, _q + 1); \
+	} else { \
+		/* move the end of the tier forward */ \
+		for (_q = _cnt; _q > _p; _q--) \
+			dcarr_tier_el((a), _k, _q) = dcarr_tier_el((a), _k, _q - 1); \
+	} \
+	dcarr_tier_el((a), _k, _p) = (value); \
+	(a).len++; \
+}while(0)
+
+/*
+ * Remove at an arbitrary position and return its value,
+ * O(tiersize + n / tiersize)
+ */
+#define dcarr_tier_remove(a, i, arraytype, value) do{ \
+	unsigned int _k = (i) / dcarr_tier_size(a); \
+	unsigned int _p = (i) % dcarr_tier_size(a); \
+	unsigned int _j, _q, _cnt; \
+	_cnt = _k == dcarr_len((a).map) - 1 \
+	       ? (a).len - _k * dcarr_tier_size(a) \
+	       : dcarr_tier_size(a); \
+	(value) = dcarr_tier_el((a), _k, _p); \
+	/* remove within tier k */ \
+	if (_p < _cnt / 2) { \
+		/* move the beginning of the tier forward */ \
+		for (_q = _p; _q > 0; _q--) \
+			dcarr_tier_el((a), _k, _q) = dcarr_tier_el((a), _k, _q - 1); \
+		dcarr_elem((a).map, _k)->off = \
+			(dcarr_elem((a).map, _k)->off + 1) & (dcarr_tier_size(a) - 1); \
+	} else { \
+		/* move the end of the tier backwards */ \
+		for (_q = _p; _q + 1 < _cnt; _q++) \
+			dcarr_tier_el((a), _k, _q) = dcarr_tier_el((a), _k, _q + 1); \
+	} \
+	/* move the first element of each following tier to the previous */ \
+	for (_j = _k + 1; _j < dcarr_len((a).map); _j++) { \
+		dcarr_tier_el((a), _j - 1, dcarr_tier_size(a) - 1) = \
+			dcarr_tier_el((a), _j, 0); \
+		dcarr_elem((a).map, _j)->off = \
+			(dcarr_elem((a).map, _j)->off + 1) & (dcarr_tier_size(a) - 1); \
+	} \
+	(a).len--; \
+	if ((a).len == (dcarr_len((a).map) - 1) * dcarr_tier_size(a)) { \
+		/* the last tier is empty */ \
+		arraytype##_tier *_tier; \
+		dcarr_pop((a).map, arraytype##_tier *, _tier); \
+		dcarr_free(_tier); \
+	} \
+}while(0)
+
+#define dcarr_tier_push(a, arraytype, value) \
+	dcarr_tier_insert((a), (a).len, arraytype, (value))
+
+#define dcarr_tier_pop(a, arraytype, value) \
+	dcarr_tier_remove((a), (a).len - 1, arraytype, (value))
+
+
+/*
+ * Gap buffers
+ *
+ * An array type defined with dcarr_gap_define_type keeps its free space
+ * as a gap at a cursor position instead of at the ends. Elements before
+ * the gap are at the start of the buffer and elements after it are at the
+ * end. Inserting or removing at the gap is O(1) and moving the gap costs
+ * a memmove of the distance, so repeated edits near the same position are
+ * cheap. The capacity grows like a dcarr's and is never reduced.
+ */
+#define dcarr_gap_define_type(arraytype, elemtype) \
+	typedef struct arraytype { \
+		elemtype *els; \
+		unsigned int cap; \
+		unsigned int gap; \
+		unsigned int len; \
+		unsigned int align; \
+		dcarr_stats_member \
+	} arraytype
+
+#define dcarr_gap_init(a) do{ \
+	(a).els = NULL; \
+	(a).cap = (a).gap = (a).len = 0; \
+	(a).align = 0; \
+	dcarr_stats_reset(a); \
+}while(0)
+
+#define dcarr_gap_destroy(a) do{ \
+	dcarr_free((a).els); \
+}while(0)
+
+/*
+ * Access the element at index i, possible to assign to.
+ */
+#define dcarr_gap_elem(a, i) \
+	((a).els[(i) < (a).gap ? (i) : (i) + (a).cap - (a).len])
+
+/*
+ * Moves the gap to be just before the element at index pos.
+ */
+#define dcarr_gap_move(a, elemtype, pos) do{ \
+	unsigned int _pos = (pos); \
+	if (_pos < (a).gap) { \
+		memmove(&((a).els[_pos + (a).cap - (a).len]), \
+		        &((a).els[_pos]), \
+		        sizeof(elemtype) * ((a).gap - _pos)); \
+		dcarr_stat((a), moved, sizeof(elemtype) * ((a).gap - _pos)); \
+	} \
+	else if (_pos > (a).gap) { \
+		memmove(&((a).els[(a).gap]), \
+		        &((a).els[(a).gap + (a).cap - (a).len]), \
+		        sizeof(elemtype) * (_pos - (a).gap)); \
+		dcarr_stat((a), moved, sizeof(elemtype) * (_pos - (a).gap)); \
+	} \
+	(a).gap = _pos; \
+}while(0)
+
+/*
+ * Insert at position i, moving the gap there. The gap ends up after the
+ * inserted element, so inserting at i + 1 next is O(1).
+ */
+#define dcarr_gap_insert(a, i, elemtype, value) do{ \
+	dcarr_gap_reserve((a), elemtype, 1); \
+	dcarr_gap_move((a), elemtype, (i)); \
+	(a).els[(a).gap++] = (value); \
+	(a).len++; \
+}while(0)
+
+/*
+ * Remove the element at position i and return its value, moving the gap
+ * there.
+ */
+#define dcarr_gap_remove(a, i, elemtype, value) do{ \
+	dcarr_gap_move((a), elemtype, (i) + 1); \
+	(value) = (a).els[--(a).gap]; \
+	(a).len--; \
+}while(0)
+
+/*
+ * Reserve space for at least n more elements.
+ */
+#define dcarr_gap_reserve(a, eltype, n) do{ \
+	if ((a).len + (n) > (a).cap) { \
+		unsigned int _cap = (a).cap; \
+		dcarr_stat((a), reserves, 1); \
+		do{ \
+			(a).cap = (a).cap >= 8 ? (a).cap << 1 : 8; \
+		}while((a).len + (n) > (a).cap); \
+		dcarr_stat_peak(a); \
+		dcarr_realloc_els((a), eltype, _cap); \
+		dcarr_stat((a), reallocs, 1); \
+		if (!(a).els) dcarr_oom(); \
+		/* move the part after the gap to the new end */ \
+		memmove(&((a).els[(a).gap + (a).cap - (a).len]), \
+		        &((a).els[(a).gap + _cap - (a).len]), \
+		        sizeof(eltype) * ((a).len - (a).gap)); \
+		dcarr_stat((a), moved, sizeof(eltype) * ((a).len - (a).gap)); \
+	} \
+}while(0)
+
+
+/*
+ * Lock-free single-producer/single-consumer queue (requires C11 atomics)
+ *
+ * A fixed capacity ring of the same power-of-2 layout, where one thread
+ * pushes and one other thread shifts. The indices grow without bound and
+ * are masked on access. Each side keeps a cached copy of the other side's
+ * index, so the shared cache line is only read when the queue looks full
+ * or empty.
+ *
+ * Push and shift don't block. They set ok (or done, for the batch
+ * versions) to tell how many elements were transferred.
+ */
+#if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L && \
+    !defined(__STDC_NO_ATOMICS__)
+#include <stdatomic.h>
+#define DCARR_ATOMICS 1
+
+#define dcarr_spsc_define_type(arraytype, elemtype) \
+	typedef struct arraytype { \
+		elemtype *els; \
+		unsigned int cap; \
+		/* written by the consumer */ \
+		_Alignas(dcarr_cacheline) atomic_uint head; \
+		unsigned int tailcache; \
+		/* written by the producer */ \
+		_Alignas(dcarr_cacheline) atomic_uint tail; \
+		unsigned int headcache; \
+	} arraytype
+
+/*
+ * Allocates room for at least capacity elements, rounded up to a power
+ * of 2. Must be done before the queue is shared between threads.
+ */
+#define dcarr_spsc_init(a, elemtype, capacity) do{ \
+	(a).cap = 1; \
+	while ((a).cap < (capacity)) (a).cap <<= 1; \
+	(a).els = (elemtype *)dcarr_alloc((a).cap * sizeof(elemtype)); \
+	if (!(a).els) dcarr_oom(); \
+	atomic_init(&(a).head, 0); \
+	atomic_init(&(a).tail, 0); \
+	(a).headcache = (a).tailcache = 0; \
+}while(0)
+
+#define dcarr_spsc_destroy(a) do{ \
+	dcarr_free((a).els); \
+}while(0)
+
+/*
+ * Sets len to the number of elements. Only a snapshot if the other side
+ * is active. The head is loaded before the tail, so that it can't have
+ * moved past the tail, and the result is at most the capacity.
+ */
+#define dcarr_spsc_len(a, len) do{ \
+	unsigned int _lh = atomic_load_explicit(&(a).head, memory_order_acquire); \
+	unsigned int _lt = atomic_load_explicit(&(a).tail, memory_order_acquire); \
+	(len) = _lt - _lh < (a).cap ? _lt - _lh : (a).cap; \
+}while(0)
+
+/*
+ * Insert an element at the end. Producer only.
+ */
+#define dcarr_spsc_push(a, elemtype, value, ok) do{ \
+	unsigned int _t = atomic_load_explicit(&(a).tail, memory_order_relaxed); \
+	if (_t - (a).headcache == (a).cap) \
+		(a).headcache = atomic_load_explicit(&(a).head, \
+		                                     memory_order_acquire); \
+	if (_t - (a).headcache == (a).cap) { \
+		(ok) = 0; \
+	} else { \
+		(a).els[_t & ((a).cap - 1)] = (value); \
+		atomic_store_explicit(&(a).tail, _t + 1, memory_order_release); \
+		(ok) = 1; \
+	} \
+}while(0)
+
+/*
+ * Remove an element at the beginning. Consumer only.
+ */
+#define dcarr_spsc_shift(a, elemtype, value, ok) do{ \
+	unsigned int _h = atomic_load_explicit(&(a).head, memory_order_relaxed); \
+	if (_h == (a).tailcache) \
+		(a).tailcache = atomic_load_explicit(&(a).tail, \
+		                                     memory_order_acquire); \
+	if (_h == (a).tailcache) { \
+		(ok) = 0; \
+	} else { \
+		(value) = (a).els[_h & ((a).cap - 1)]; \
+		atomic_store_explicit(&(a).head, _h + 1, memory_order_release); \
+		(ok) = 1; \
+	} \
+}while(0)
+
+/*
+ * Insert up to n elements from the C array src at the end, using at most
+ * two memcpy. Sets done to the number of elements inserted. Producer only.
+ */
+#define dcarr_spsc_push_n(a, elemtype, src, n, done) do{ \
+	unsigned int _t = atomic_load_explicit(&(a).tail, memory_order_relaxed); \
+	unsigned int _i, _k; \
+	if ((a).cap - (_t - (a).headcache) < (n)) \
+		(a).headcache = atomic_load_explicit(&(a).head, \
+		                                     memory_order_acquire); \
+	_k = (a).cap - (_t - (a).headcache); \
+	if (_k > (n)) _k = (n); \
+	_i = _t & ((a).cap - 1); \
+	if (_i + _k > (a).cap) { \
+		memcpy(&((a).els[_i]), (src), \
+		       sizeof(elemtype) * ((a).cap - _i)); \
+		memcpy(&((a).els[0]), &((src)[(a).cap - _i]), \
+		       sizeof(elemtype) * (_i + _k - (a).cap)); \
+	} else { \
+		memcpy(&((a).els[_i]), (src), sizeof(elemtype) * _k); \
+	} \
+	atomic_store_explicit(&(a).tail, _t + _k, memory_order_release); \
+	(done) = _k; \
+}while(0)
+
+/*
+ * Remove up to n elements at the beginning into the C array dst, using at
+ * most two memcpy. Sets done to the number of elements removed. Consumer
+ * only.
+ */
+#define dcarr_spsc_shift_n(a, elemtype, dst, n, done) do{ \
+	unsigned int _h = atomic_load_explicit(&(a).head, memory_order_relaxed); \
+	unsigned int _i, _k; \
+	if ((a).tailcache - _h < (n)) \
+		(a).tailcache = atomic_load_explicit(&(a).tail, \
+		                                     memory_order_acquire); \
+	_k = (a).tailcache - _h; \
+	if (_k > (n)) _k = (n); \
+	_i = _h & ((a).cap - 1); \
+	if (_i + _k > (a).cap) { \
+		memcpy((dst), &((a).els[_i]), \
+		       sizeof(elemtype) * ((a).cap - _i)); \
+		memcpy(&((dst)[(a).cap - _i]), &((a).els[0]), \
+		       sizeof(elemtype) * (_i + _k - (a).cap)); \
+	} else { \
+		memcpy((dst), &((a).els[_i]), sizeof(elemtype) * _k); \
+	} \
+	atomic_store_explicit(&(a).head, _h + _k, memory_order_release); \
+	(done) = _k; \
+}while(0)
+
+/*
+ * Bounded multi-producer/multi-consumer queue (requires C11 atomics)
+ *
+ * Any number of threads may push and shift concurrently. Each slot has a
+ * sequence number telling whether it is ready to be written or read in
+ * the current lap around the ring (Dmitry Vyukov's algorithm), so threads
+ * only contend on the head or tail index with a single CAS.
+ */
+#define dcarr_mpmc_define_type(arraytype, elemtype) \
+	typedef struct arraytype { \
+		struct arraytype##_slot { \
+			atomic_uint seq; \
+			elemtype val; \
+		} *els; \
+		unsigned int cap; \
+		_Alignas(dcarr_cacheline) atomic_uint head; \
+		_Alignas(dcarr_cacheline) atomic_uint tail; \
+	} arraytype
+
+/*
+ * Allocates room for at least capacity elements, rounded up to a power
+ * of 2, and at least 2. With a single slot its sequence numbers can't
+ * tell a full slot from an empty one. Must be done before the queue is
+ * shared between threads.
+ */
+#define dcarr_mpmc_init(a, arraytype, capacity) do{ \
+	unsigned int _i; \
+	(a).cap = 2; \
+	while ((a).cap < (capacity)) (a).cap <<= 1; \
+	(a).els = (struct arraytype##_slot *) \
+		dcarr_alloc((a).cap * sizeof(*(a).els)); \
+	if (!(a).els) dcarr_oom(); \
+	for (_i = 0; _i < (a).cap; _i++) \
+		atomic_init(&(a).els[_i].seq, _i); \
+	atomic_init(&(a).head, 0); \
+	atomic_init(&(a).tail, 0); \
+}while(0)
+
+#define dcarr_mpmc_destroy(a) do{ \
+	dcarr_free((a).els); \
+}while(0)
+
+/*
+ * Insert an element at the end. Sets ok to 0 if the queue is full.
+ */
+#define dcarr_mpmc_push(a, elemtype, value, ok) do{ \
+	unsigned int _p = atomic_load_explicit(&(a).tail, memory_order_relaxed); \
+	int _d; \
+	for (;;) { \
+		_d = (int)(atomic_load_explicit(&(a).els[_p & ((a).cap - 1)].seq, \
+		                                memory_order_acquire) - _p); \
+		if (_d == 0) { \
+			/* the slot is free in this lap. claim it. */ \
+			if (atomic_compare_exchange_weak_explicit(&(a).tail, &_p, \
+			        _p + 1, memory_order_relaxed, memory_order_relaxed)) \
+				break; \
+		} \
+		else if (_d < 0) break; /* full */ \
+		else _p = atomic_load_explicit(&(a).tail, memory_order_relaxed); \
+	} \
+	if (_d == 0) { \
+		(a).els[_p & ((a).cap - 1)].val = (value); \
+		atomic_store_explicit(&(a).els[_p & ((a).cap - 1)].seq, _p + 1, \
+		                      memory_order_release); \
+	} \
+	(ok) = _d == 0; \
+}while(0)
+
+/*
+ * Remove an element at the beginning. Sets ok to 0 if the queue is empty.
+ */
+#define dcarr_mpmc_shift(a, elemtype, value, ok) do{ \
+	unsigned int _p = atomic_load_explicit(&(a).head, memory_order_relaxed); \
+	int _d; \
+	for (;;) { \
+		_d = (int)(atomic_load_explicit(&(a).els[_p & ((a).cap - 1)].seq, \
+		                                memory_order_acquire) - (_p + 1)); \
+		if (_d == 0) { \
+			/* the slot is written in this lap. claim it. */ \
+			if (atomic_compare_exchange_weak_explicit(&(a).head, &_p, \
+			        _p + 1, memory_order_relaxed, memory_order_relaxed)) \
+				break; \
+		} \
+		else if (_d < 0) break; /* empty */ \
+		else _p = atomic_load_explicit(&(a).head, memory_order_relaxed); \
+	} \
+	if (_d == 0) { \
+		(value) = (a).els[_p & ((a).cap - 1)].val; \
+		/* free the slot for the next lap */ \
+		atomic_store_explicit(&(a).els[_p & ((a).cap - 1)].seq, \
+		                      _p + (a).cap, memory_order_release); \
+	} \
+	(ok) = _d == 0; \
+}while(0)
+
+
+/*
+ * Chase-Lev work-stealing deque (requires C11 atomics)
+ *
+ * The owner thread pushes and pops at the end without locking, while any
+ * number of thieves steal from the beginning with a CAS. The slots are
+ * atomic, so the element type should be small enough to be lock-free,
+ * such as a pointer to a task. This follows "Correct and Efficient
+ * Work-Stealing for Weak Memory Models" by Lê et al.
+ *
+ * When the owner grows the ring, the new buffer is published and the old
+ * one is put on a list of retired buffers, since a thief may still be
+ * reading from it. Thieves count themselves in thieves while they use a
+ * buffer, and the retired buffers are freed when the owner sees the count
+ * at zero after publishing the new buffer, which means no thief can still
+ * reach them. Otherwise they are kept until the next growth,
+ * dcarr_ws_reclaim or dcarr_ws_destroy.
+ */
+#define dcarr_ws_define_type(arraytype, elemtype) \
+	typedef struct arraytype##_buf { \
+		struct arraytype##_buf *prev; \
+		long cap; \
+		_Atomic(elemtype) els[]; \
+	} arraytype##_buf; \
+	typedef struct arraytype { \
+		arraytype##_buf *cur;     /* the owner's copy of buf */ \
+		arraytype##_buf *retired; /* old buffers, newest first */ \
+		_Atomic(arraytype##_buf *) buf; \
+		/* written by thieves */ \
+		_Alignas(dcarr_cacheline) atomic_long top; \
+		atomic_uint thieves; /* thieves using a buffer */ \
+		/* written by the owner */ \
+		_Alignas(dcarr_cacheline) atomic_long bottom; \
+	} arraytype
+
+/*
+ * Allocates room for at least capacity elements, rounded up to a power
+ * of 2. Must be done before the deque is shared between threads.
+ */
+#define dcarr_ws_init(a, arraytype, capacity) do{ \
+	long _cap = 1; \
+	while (_cap < (capacity)) _cap <<= 1; \
+	(a).cur = (arraytype##_buf *)dcarr_alloc(sizeof(*(a).cur) + \
+	                      _cap * sizeof((a).cur->els[0])); \
+	if (!(a).cur) dcarr_oom(); \
+	(a).cur->prev = NULL; \
+	(a).cur->cap = _cap; \
+	(a).retired = NULL; \
+	atomic_init(&(a).buf, (a).cur); \
+	atomic_init(&(a).top, 0); \
+	atomic_init(&(a).thieves, 0); \
+	atomic_init(&(a).bottom, 0); \
+}while(0)
+
+#define dcarr_ws_destroy(a) do{ \
+	dcarr_ws_free_retired(a); \
+	dcarr_free((a).cur); \
+}while(0)
+
+/*
+ * Frees the buffers retired by growing, if no thief is using a buffer.
+ * Sets ok to 0 if they had to be kept. Owner only.
+ */
+#define dcarr_ws_reclaim(a, ok) do{ \
+	(ok) = atomic_load_explicit(&(a).thieves, memory_order_seq_cst) == 0; \
+	if (ok) dcarr_ws_free_retired(a); \
+}while(0)
+
+/*
+ * Frees the retired buffers. (Used internally.)
+ */
+#define dcarr_ws_free_retired(a) do{ \
+	while ((a).retired) { \
+		void *_r = (a).retired; \
+		(a).retired = (a).retired->prev; \
+		dcarr_free(_r); \
+	} \
+}while(0)
+
+/*
+ * Insert an element at the end. Owner only. This one takes the array
+ * type for the new buffer when growing.
+ */
+#define dcarr_ws_push(a, arraytype, value) do{ \
+	long _b = atomic_load_explicit(&(a).bottom, memory_order_relaxed); \
+	long _t = atomic_load_explicit(&(a).top, memory_order_acquire); \
+	if (_b - _t > (a).cur->cap - 1) \
+		dcarr_ws_grow((a), arraytype, _t, _b); \
+	atomic_store_explicit(&(a).cur->els[_b & ((a).cur->cap - 1)], \
+	                      (value), memory_order_relaxed); \
+	atomic_thread_fence(memory_order_release); \
+	atomic_store_explicit(&(a).bottom, _b + 1, memory_order_relaxed); \
+}while(0)
+
+/*
+ * Remove an element at the end. Sets ok to 0 if the deque was empty or
+ * the last element was stolen. Owner only.
+ */
+#define dcarr_ws_pop(a, elemtype, value, ok) do{ \
+	long _b = atomic_load_explicit(&(a).bottom, memory_order_relaxed) - 1; \
+	long _t; \
+	atomic_store_explicit(&(a).bottom, _b, memory_order_relaxed); \
+	atomic_thread_fence(memory_order_seq_cst); \
+	_t = atomic_load_explicit(&(a).top, memory_order_relaxed); \
+	(ok) = _t <= _b; \
+	if (_t <= _b) { \
+		(value) = atomic_load_explicit( \
+			&(a).cur->els[_b & ((a).cur->cap - 1)], memory_order_relaxed); \
+		if (_t == _b) { \
+			/* the last element. race against thieves. */ \
+			if (!atomic_compare_exchange_strong_explicit(&(a).top, &_t, \
+			        _t + 1, memory_order_seq_cst, memory_order_relaxed)) \
+				(ok) = 0; \
+			atomic_store_explicit(&(a).bottom, _b + 1, \
+			                      memory_order_relaxed); \
+		} \
+	} else { \
+		atomic_store_explicit(&(a).bottom, _b + 1, memory_order_relaxed); \
+	} \
+}while(0)
+
+/*
+ * Remove an element at the beginning. Sets ok to 0 if the deque was empty
+ * or another thread took the element first, in which case value is
+ * garbage. Any thread. This one takes the array type, as the buffer
+ * pointer must only be loaded once.
+ */
+#define dcarr_ws_steal(a, arraytype, value, ok) do{ \
+	long _t = atomic_load_explicit(&(a).top, memory_order_acquire); \
+	long _b; \
+	atomic_thread_fence(memory_order_seq_cst); \
+	_b = atomic_load_explicit(&(a).bottom, memory_order_acquire); \
+	(ok) = 0; \
+	if (_t < _b) { \
+		arraytype##_buf *_buf; \
+		/* keep the owner from freeing the buffer while reading it */ \
+		atomic_fetch_add_explicit(&(a).thieves, 1, memory_order_seq_cst); \
+		_buf = atomic_load_explicit(&(a).buf, memory_order_seq_cst); \
+		(value) = atomic_load_explicit(&_buf->els[_t & (_buf->cap - 1)], \
+		                               memory_order_relaxed); \
+		atomic_fetch_sub_explicit(&(a).thieves, 1, memory_order_release); \
+		(ok) = atomic_compare_exchange_strong_explicit(&(a).top, &_t, \
+		        _t + 1, memory_order_seq_cst, memory_order_relaxed); \
+	} \
+}while(0)
+
+/*
+ * Doubles the capacity, copying the elements from t to b and publishing
+ * the new buffer. A thief which counted itself after the store sees the
+ * new buffer, so if there are none, the old ones are freed.
+ * (Used internally.)
+ */
+#define dcarr_ws_grow(a, arraytype, t, b) do{ \
+	long _i; \
+	(a).cur->prev = (a).retired; \
+	(a).retired = (a).cur; \
+	(a).cur = (arraytype##_buf *)dcarr_alloc(sizeof(*(a).cur) + \
+	                      2 * (a).retired->cap * sizeof((a).cur->els[0])); \
+	if (!(a).cur) dcarr_oom(); \
+	(a).cur->cap = 2 * (a).retired->cap; \
+	for (_i = (t); _i < (b); _i++) \
+		atomic_store_explicit(&(a).cur->els[_i & ((a).cur->cap - 1)], \
+			atomic_load_explicit( \
+				&(a).retired->els[_i & ((a).retired->cap - 1)], \
+				memory_order_relaxed), \
+			memory_order_relaxed); \
+	atomic_store_explicit(&(a).buf, (a).cur, memory_order_seq_cst); \
+	if (atomic_load_explicit(&(a).thieves, memory_order_seq_cst) == 0) \
+		dcarr_ws_free_retired(a); \
+}while(0)
+
+
+#endif /* C11 atomics */
+
+
 #endif